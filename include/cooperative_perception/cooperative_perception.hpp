@@ -1,10 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <despot/planner.h>
 
 #include "cooperative_perception/cp_pomdp.hpp"
+#include "cooperative_perception/cp_despot.hpp"
 #include "cooperative_perception/cp_world.hpp"
+#include "cooperative_perception/cp_sim_world.hpp"
 #include "cooperative_perception/operator_model.hpp"
 #include "cooperative_perception/vehicle_model.hpp"
 #include "cooperative_perception/modelbase_planner.hpp"
@@ -25,7 +28,9 @@ class CooperativePerception: public Planner
 {
 public:
 	CooperativePerception();
+    CooperativePerception(rclcpp::Node::SharedPtr node, rclcpp::CallbackGroup::SharedPtr callback_group = nullptr, const std::atomic<bool>* stop_requested = nullptr);
     int RunPlanning(int argc, char* argv[]);
+    int RunEpisode(CPSimWorld* world, const std::string &policy_type, const bool persistent_planner, const int num_search_workers, double &discounted_reward, double &undiscounted_reward);
 
 private:
     // params
@@ -36,22 +41,55 @@ private:
     // model parameters
     string policy_type_ = "DESPOT"; // DESPOT, MYOPIC, EGOISTIC
     string belief_type_ = "DEFAULT";
+    // keep model and DESPOT tree across steps (DESPOT only), parameter persistent_planner of the node
+    bool persistent_planner_ = false;
+    // the re-rooted tree is searched further only while the observation agrees with its particles
+    double reuse_speed_tolerance_ = 1.0;        // [m/s] observed ego speed vs mean particle speed
+    double reuse_pose_tolerance_ = 2.0;         // [m] observed distance to each target vs the particles
+    double reuse_likelihood_tolerance_ = 0.05;  // likelihood of the world vs the belief
+    // threads of the persistent DESPOT search (clipped to the hardware concurrency)
+    int num_search_workers_ = 8;
+    // transition cache statistics after every search, parameter print_cache_stats of the node
+    bool print_cache_stats_ = false;
+
+    // anytime search (DESPOT only)
+    double step_deadline_ = -1.0;   // [s] wall time of one step from step_start_t, <= 0: time_per_move
+    double deadline_margin_ = 0.05; // [s] kept free for jitter
+    double min_search_time_ = 0.05; // [s] less budget than this -> fallback action
+    double latency_decay_ = 0.2;    // weight of a new sample when the latency goes down
+    double post_search_latency_ = 0.0; // [s] estimated time from the end of the search to the end of the step
     
-    // pomdp
-    option::Option *options_;
+    // pomdp, despot command line options (nullptr: RunEpisode, no command line)
+    option::Option *options_ = nullptr;
     
     // models
     OperatorModel *operator_model_;
     VehicleModel *vehicle_model_;
+
+    // node of the component container (nullptr: standalone, CPWorld creates its own)
+    rclcpp::Node::SharedPtr node_ = nullptr;
+    rclcpp::CallbackGroup::SharedPtr callback_group_ = nullptr;
+    // set by the owner of the planning thread, the loop ends after the current step (nullptr: never)
+    const std::atomic<bool>* stop_requested_ = nullptr;
+
+    // persistent planner
+    CPPOMDP *persistent_model_ = nullptr;
+    CPDESPOT *persistent_solver_ = nullptr;
     
 private:
     void PlanningLoop(Solver*& solver, World* world, DSPOMDP* model, Logger* logger);
+    bool IsStopRequested() const;
     bool RunStep(Solver* solver, World* world, DSPOMDP* model, Logger* logger); 
+    double GetSearchBudget(const double step_start_t) const;
+    void UpdateLatency(const double post_search_time);
+    ACT_TYPE FallbackAction(DSPOMDP* model, Belief* belief, World* world);
     void InitializeDefaultParameters(); 
     Solver* CPInitializeSolver(DSPOMDP *model, Belief *belief, World *world);
     std::string ChooseSolver();
     DSPOMDP* InitializeModel(option::Option* options);
-    CPPOMDP* InitializeModel (State* state);
+    CPPOMDP* InitializeModel (const CPScenario* scenario);
+    CPPOMDP* UpdatePersistentPlanner (State* state, const std::vector<double>& likelihood_list, CPWorldBase* world);
+    bool IsTreeConsistent (const State* state, const std::vector<double>& likelihood_list, const CPWorldBase* world) const;
     World* InitializeWorld(int argc, char* argv[], std::string& world_type, DSPOMDP* model, option::Option* options);
     World* InitializeWorld(std::string& world_type, DSPOMDP* model, option::Option* options);
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "despot/solver/despot.h"
+#include "despot/core/node.h"
+
+#include "cooperative_perception/cp_worker.hpp"
+
+namespace despot {
+
+/* one independent DESPOT tree of the parallel search */
+struct CPSearchWorker {
+    VNode* root = NULL;
+    // streams the tree was built with (particles index them by scenario_id)
+    RandomStreams streams;
+    ScenarioLowerBound* lower_bound = NULL;
+    ScenarioUpperBound* upper_bound = NULL;
+    SearchStatistics statistics;
+    int num_trials = 0;
+
+    CPSearchWorker(const int num_scenarios, const int stream_length)
+        : streams(num_scenarios, stream_length) {}
+};
+
+/* DESPOT solver which keeps its search tree across planning steps.
+ * BeliefUpdate re-roots the tree at the (action, observation) child and the
+ * next Search continues trials from it instead of rebuilding from scratch.
+ * the search depth counts from the current root, so a re-rooted tree keeps the horizon
+ * of a new one. the streams are long enough for roots down to max_root_depth_.
+ * Search moves Globals::config.search_depth by the root depth until its workers return,
+ * so no other search or reader of the despot config may run in the process at the same time.
+ *
+ * with more than one worker the search is root parallel: each worker thread grows
+ * its own tree from its own sampled scenarios, and the action values of the roots
+ * are averaged. the model must provide per-worker memory (see CPPOMDP::SetNumWorkers).
+ *
+ * the search is anytime: with SetDeadline it stops at the deadline even before
+ * time_per_move has passed and returns the best root action found so far.
+ * a trial (or a new tree) is only started if it is expected to end by the deadline,
+ * Search returns action -1 if no tree could be searched at all.
+ */
+class CPDESPOT: public DESPOT {
+protected:
+    std::vector<CPSearchWorker> workers_;
+    bool is_reused_;
+    // absolute time (get_time_second) the next Search has to return by, <= 0: time_per_move only
+    double deadline_ = -1.0;
+    // [s] wall time of one trial of the slowest worker in the last Search
+    double trial_time_ = 0.0;
+    // search_depth of Globals::config at construction, relative to the root
+    int search_depth_;
+    // deepest root a tree is kept for, deeper -> rebuilt at depth 0
+    int max_root_depth_;
+
+public:
+    // minimum share of the scenarios the re-rooted child has to keep
+    double min_reuse_ratio_ = 0.2;
+
+public:
+    CPDESPOT(const DSPOMDP* model, ScenarioLowerBound* lb, ScenarioUpperBound* ub, Belief* belief = NULL, const int num_workers = 1);
+    ~CPDESPOT();
+
+    ValuedAction Search();
+    void BeliefUpdate(ACT_TYPE action, OBS_TYPE obs);
+    void belief(Belief* b);
+    Belief* belief();
+
+    bool HasTree() const;
+    void ResetTree();
+    int NumWorkers() const;
+    void SetDeadline(const double deadline_t);
+
+protected:
+    void SearchWorker(const int worker_id, std::vector<State*>& particles, const double end_t);
+    void FreeTree(const int worker_id);
+    ValuedAction MergeRoots() const;
+};
+
+} // namespace despot
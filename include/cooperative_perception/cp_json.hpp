@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* minimal json value for the scenario configs (config/param_*.json) and the evaluation logs.
+ * objects, arrays, numbers, strings, true/false/null; no unicode escapes.
+ * trailing commas as written in the configs are accepted.
+ */
+class CPJson {
+public:
+    enum Type {NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT};
+
+    Type type = NUL;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<CPJson> array;
+    std::vector<std::pair<std::string, CPJson>> object; // keeps the order of the file
+
+public:
+    /* member of an object, nullptr if it does not exist */
+    const CPJson* Get(const std::string &key) const {
+        for (const auto &member : object) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+
+    static bool Parse(const std::string &text, CPJson &out, std::string &error) {
+        out = CPJson();
+        size_t pos = 0;
+        if (!ParseValue(text, pos, out, error)) return false;
+        SkipSpace(text, pos);
+        if (pos != text.size()) {
+            error = "unexpected text at " + std::to_string(pos);
+            return false;
+        }
+        return true;
+    }
+
+    static bool Load(const std::string &path, CPJson &out, std::string &error) {
+        std::ifstream file(path);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return Parse(ss.str(), out, error);
+    }
+
+    /* string literal which Parse reads back */
+    static std::string Quote(const std::string &value) {
+        std::string out = "\"";
+        for (const char c : value) {
+            if (c == '\n') {
+                out += "\\n";
+                continue;
+            }
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+private:
+    static void SkipSpace(const std::string &text, size_t &pos) {
+        while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' || text[pos] == '\r' || text[pos] == '\t')) pos++;
+    }
+
+    static bool Expect(const std::string &text, size_t &pos, const std::string &word, std::string &error) {
+        if (text.compare(pos, word.size(), word) != 0) {
+            error = "expected " + word + " at " + std::to_string(pos);
+            return false;
+        }
+        pos += word.size();
+        return true;
+    }
+
+    static bool ParseString(const std::string &text, size_t &pos, std::string &out, std::string &error) {
+        pos++; // "
+        out.clear();
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c == '\\' && pos < text.size()) {
+                c = text[pos++];
+                if (c == 'n') c = '\n';
+                else if (c == 't') c = '\t';
+            }
+            out += c;
+        }
+        if (pos >= text.size()) {
+            error = "unterminated string";
+            return false;
+        }
+        pos++; // "
+        return true;
+    }
+
+    static bool ParseValue(const std::string &text, size_t &pos, CPJson &out, std::string &error) {
+        SkipSpace(text, pos);
+        if (pos >= text.size()) {
+            error = "unexpected end";
+            return false;
+        }
+
+        const char c = text[pos];
+        if (c == '{' || c == '[') {
+            const bool is_object = (c == '{');
+            const char close = is_object ? '}' : ']';
+            out.type = is_object ? OBJECT : ARRAY;
+            pos++;
+            while (true) {
+                SkipSpace(text, pos);
+                if (pos < text.size() && text[pos] == close) {
+                    pos++;
+                    return true;
+                }
+
+                std::string key;
+                if (is_object) {
+                    if (pos >= text.size() || text[pos] != '"') {
+                        error = "expected key at " + std::to_string(pos);
+                        return false;
+                    }
+                    if (!ParseString(text, pos, key, error)) return false;
+                    SkipSpace(text, pos);
+                    if (!Expect(text, pos, ":", error)) return false;
+                }
+
+                CPJson value;
+                if (!ParseValue(text, pos, value, error)) return false;
+                if (is_object) {
+                    out.object.emplace_back(std::move(key), std::move(value));
+                }
+                else {
+                    out.array.emplace_back(std::move(value));
+                }
+
+                /* "," or the closing bracket, a "," right before it is fine */
+                SkipSpace(text, pos);
+                if (pos < text.size() && text[pos] == ',') {
+                    pos++;
+                }
+                else if (pos >= text.size() || text[pos] != close) {
+                    error = std::string("expected , or ") + close + " at " + std::to_string(pos);
+                    return false;
+                }
+            }
+        }
+        else if (c == '"') {
+            out.type = STRING;
+            return ParseString(text, pos, out.string, error);
+        }
+        else if (c == 't' || c == 'f') {
+            out.type = BOOL;
+            out.boolean = (c == 't');
+            return Expect(text, pos, out.boolean ? "true" : "false", error);
+        }
+        else if (c == 'n') {
+            out.type = NUL;
+            return Expect(text, pos, "null", error);
+        }
+
+        const char *begin = text.c_str() + pos;
+        char *end = nullptr;
+        out.type = NUMBER;
+        out.number = std::strtod(begin, &end);
+        if (end == begin) {
+            error = "unexpected character at " + std::to_string(pos);
+            return false;
+        }
+        pos += end - begin;
+        return true;
+    }
+};
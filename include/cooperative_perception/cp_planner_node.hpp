@@ -0,0 +1,40 @@
+#pragma once
+#include "rclcpp/rclcpp.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cooperative_perception/cooperative_perception.hpp"
+#include "cooperative_perception/cp_thread.hpp"
+
+/* planner as a composable node.
+ * the planning loop runs on its own thread (planner.*), the state subscription and
+ * the service responses on an io thread (planner_io.*), see CPThreadConfig.
+ * the DESPOT search workers inherit the setting of the planner thread.
+ *
+ * despot options (-t, -n, solver flags) are the non-ROS arguments of the node options,
+ * the program name first as in argv (cooperative_perception_node passes its command line).
+ * the planning thread does not own the node: unloading the component stops the loop
+ * after the current step and joins the thread.
+ */
+class CPPlannerNode: public rclcpp::Node {
+public:
+    explicit CPPlannerNode(const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
+    ~CPPlannerNode();
+
+private:
+    rclcpp::TimerBase::SharedPtr start_timer_;
+    std::thread planner_thread_;
+    CPThreadConfig planner_config_;
+    std::vector<std::string> planner_args_;
+    // shared with the planning thread, which may outlive a node destroyed from that thread
+    std::shared_ptr<std::atomic<bool>> stop_requested_;
+    rclcpp::CallbackGroup::SharedPtr io_group_;
+    CPExecutorThread io_thread_;
+
+private:
+    void Start();
+};
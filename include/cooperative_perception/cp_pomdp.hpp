@@ -5,12 +5,115 @@
 #include "cooperative_perception/operator_model.hpp"
 #include "cooperative_perception/libgeometry.hpp"
 #include "cooperative_perception/vehicle_model.hpp"
+#include "cooperative_perception/cp_worker.hpp"
 
 namespace despot {
 
+/* particle set in structure-of-arrays layout for CPPOMDP::StepBatch.
+ * index keeps the position of each entry in the particle list it was loaded from.
+ */
+struct CPParticleBatch {
+    // state
+    std::vector<double> ego_speed;
+    std::vector<int> ego_pose;
+    std::vector<int> req_time;
+    std::vector<int> req_target;
+    std::vector<uint64_t> ego_recog;
+    std::vector<uint64_t> risk_bin;
+    std::vector<double> weight;
+    std::vector<int> scenario_id;
+    std::vector<int> index;
+
+    // StepBatch output
+    std::vector<double> reward;
+    std::vector<OBS_TYPE> obs;
+    std::vector<uint8_t> terminal;
+
+    // state before StepBatch
+    std::vector<double> prev_speed;
+    std::vector<int> prev_pose;
+    std::vector<int> prev_req_time;
+    std::vector<int> prev_req_target;
+    std::vector<int> buf_reward;
+
+    int Size() const {
+        return ego_speed.size();
+    }
+
+    void Resize(const int num) {
+        ego_speed.resize(num);
+        ego_pose.resize(num);
+        req_time.resize(num);
+        req_target.resize(num);
+        ego_recog.resize(num);
+        risk_bin.resize(num);
+        weight.resize(num);
+        scenario_id.resize(num);
+        index.resize(num);
+        reward.resize(num);
+        obs.resize(num);
+        terminal.resize(num);
+        prev_speed.resize(num);
+        prev_pose.resize(num);
+        prev_req_time.resize(num);
+        prev_req_target.resize(num);
+        buf_reward.resize(num);
+    }
+
+    void Load(const std::vector<State*>& particles) {
+        Resize(particles.size());
+        for (int i = 0; i < Size(); i++) {
+            const CPState* state = static_cast<const CPState*>(particles[i]);
+            ego_speed[i] = state->ego_speed;
+            ego_pose[i] = state->ego_pose;
+            req_time[i] = state->req_time;
+            req_target[i] = state->req_target;
+            ego_recog[i] = state->ego_recog;
+            risk_bin[i] = state->risk_bin;
+            weight[i] = state->weight;
+            scenario_id[i] = state->scenario_id;
+            index[i] = i;
+        }
+    }
+
+    void Store(const int i, CPState* state) const {
+        state->ego_speed = ego_speed[i];
+        state->ego_pose = ego_pose[i];
+        state->req_time = req_time[i];
+        state->req_target = req_target[i];
+        state->ego_recog = ego_recog[i];
+        state->risk_bin = risk_bin[i];
+        state->weight = weight[i];
+        state->scenario_id = scenario_id[i];
+    }
+
+    // drop entries which reached a terminal state, keeps the order of the rest
+    void RemoveTerminal() {
+        int num = 0;
+        for (int i = 0; i < Size(); i++) {
+            if (terminal[i]) continue;
+            ego_speed[num] = ego_speed[i];
+            ego_pose[num] = ego_pose[i];
+            req_time[num] = req_time[i];
+            req_target[num] = req_target[i];
+            ego_recog[num] = ego_recog[i];
+            risk_bin[num] = risk_bin[i];
+            weight[num] = weight[i];
+            scenario_id[num] = scenario_id[i];
+            index[num] = index[i];
+            reward[num] = reward[i];
+            obs[num] = obs[i];
+            terminal[num] = 0;
+            num++;
+        }
+        Resize(num);
+    }
+};
+
 class CPPOMDP: public DSPOMDP {
 protected:
-	mutable MemoryPool<CPState>      memory_pool;
+	// one pool per search worker (CPWorker::Id), particles are allocated without locking
+	mutable std::vector<MemoryPool<CPState>*> memory_pools_;
 	// std::vector<CPState*>            states;
 	// mutable std::vector<ValuedAction> mdp_policy;
 	// OperatorModel                     operator_model;
@@ -24,6 +127,10 @@ private:
 	int r_request        = -1;
 
     int max_perception_num_ = 3;
+    // more targets than this -> sample the initial belief instead of enumerating 2^N combinations
+    int max_enum_targets_ = 8;
+    // samples per sampling thread, fewer samples (a belief of ~100 particles) are drawn on the calling thread
+    int min_samples_per_worker_ = 2048;
 
 	// state transition parameter
 	int    planning_horizon_;
@@ -35,13 +142,16 @@ private:
 
 public:
     CPPOMDP ();
-    CPPOMDP (const int planning_horizon, const double risk_thresh, const double delta_t, VehicleModel* vehicle_model, OperatorModel* operator_model, State* state); 
+    CPPOMDP (const int planning_horizon, const double risk_thresh, const double delta_t, VehicleModel* vehicle_model, OperatorModel* operator_model, const CPScenario* scenario); 
+    ~CPPOMDP ();
 
 
     VehicleModel* vehicle_model_;
     OperatorModel* operator_model_;
     // CPState* cp_state_;
     CPValues* cp_values_;
+    // target layout of the current step, shared by all particles
+    CPScenario scenario_;
 	// recognition likelihood of the ADSbelief(belief);::vector<double> risk_recog;
     // std::vector<double> risk_likelihood_;
 	// std::vector<int> risk_positions_;
@@ -51,12 +161,18 @@ public:
 	// Essential
 	int NumActions() const;
 	bool Step (State& state, double rand_num, ACT_TYPE action, double& reward, OBS_TYPE& obs) const;
+	void StepBatch (CPParticleBatch& batch, const double* rand_nums, ACT_TYPE action) const;
 	double ObsProb (OBS_TYPE obs, const State& state, ACT_TYPE action) const;
 	Belief* InitialBelief (const State* start, std::string type = "DEFAULT") const;
 	Belief* InitialBelief (const State* start, const std::vector<double>& likelihood, std::string type = "DEFAULT") const;
+	Belief* PatchBelief (const Belief* prev_belief, const State* start, const std::vector<double>& likelihood, const std::vector<int>& prev_idx_list) const;
+	void SyncTargets (const CPScenario* scenario);
+	void SetNumWorkers (const int num_workers);
 
 	double GetMaxReward () const;
 	ValuedAction GetBestAction () const;
+	// reward of one transition, CPSimWorld scores its episodes with it
+	int CalcReward (const State& state_prev, const State& state_curr, const ACT_TYPE& action) const;
     std::vector<double> GetPerceptionLikelihood (const Belief* belief);
     ScenarioUpperBound* CreateScenarioUpperBound (std::string name, std::string particle_bound_name) const; 
     ScenarioLowerBound* CreateScenarioLowerBound (std::string name, std::string particle_bound_name) const;
@@ -69,6 +185,7 @@ public:
 	State* Copy (const State* particle) const;
 	void Free (State* particle) const;
 	int NumActiveParticles () const;
+	MemoryPool<CPState>* WorkerPool () const;
 
     // void syncCurrentState(State* state, std::vector<double>& likelihood_list);
 	void PrintState (const State& state, std::ostream& out = std::cout) const;
@@ -78,8 +195,8 @@ public:
 
 protected:
 	void EgoVehicleTransition (int& pose, double& speed, const std::vector<bool>& recog_list, const std::vector<int>& target_poses, const ACT_TYPE& action) const ;
-	int CalcReward (const State& state_prev, const State& state_curr, const ACT_TYPE& action) const;
     void GetBinProduct (std::vector<std::vector<bool>>& out_list, std::vector<bool> buf, int row) const ;
+    void SampleBinProduct (std::vector<std::vector<bool>>& out_list, const std::vector<double>& likelihood, int num) const ;
 };
 
 } // namespace despot
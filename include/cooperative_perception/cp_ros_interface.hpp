@@ -1,6 +1,10 @@
 #pragma once
 #include "rclcpp/rclcpp.hpp"
 
+#include <thread>
+#include <functional>
+#include <mutex>
+
 #include <geometry_msgs/msg/pose_with_covariance_stamped.hpp>
 #include <geometry_msgs/msg/twist_with_covariance_stamped.hpp>
 #include <nav_msgs/msg/path.hpp>
@@ -13,10 +17,18 @@
 
 #include "cooperative_perception/msg/cp_intervention.hpp"
 #include "cooperative_perception/msg/cp_predicted_object.hpp"
+#include "cooperative_perception/msg/cp_predicted_object_array.hpp"
+#include "cooperative_perception/msg/cp_planner_state.hpp"
 #include "cooperative_perception/srv/intervention.hpp"
 #include "cooperative_perception/srv/state.hpp"
 #include "cooperative_perception/srv/update_perception.hpp"
+#include "cooperative_perception/srv/planner_tick.hpp"
 #include "cooperative_perception/libgeometry.hpp"
+#include "cooperative_perception/cp_trajectory_index.hpp"
+#include "cooperative_perception/cp_uuid.hpp"
+#include "cooperative_perception/cp_snapshot.hpp"
+#include "cooperative_perception/cp_spsc_queue.hpp"
+#include "cooperative_perception/cp_thread.hpp"
 
 
 using std::placeholders::_1;
@@ -24,21 +36,109 @@ using std::placeholders::_2;
 
 class CPRosInterface: public rclcpp::Node {
 public:
-    CPRosInterface();
+    explicit CPRosInterface(const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
+    ~CPRosInterface();
     struct Object {
-        autoware_auto_perception_msgs::msg::PredictedObject predicted_object;
-        int decay_time;
+        // entry of the message the object was last seen in, the message is shared instead of copied
+        autoware_auto_perception_msgs::msg::PredictedObjects::ConstSharedPtr source;
+        int source_index;
+        double last_seen; // [s] header stamp of that message
         double collision_prob;
         double collision_point;
         int collision_path_index; 
+        // crossing point along the trajectory from its first point, < 0: no crossing found yet
+        double collision_arc;
+        // inputs of the last collision computation
+        uint64_t trajectory_generation;
+        uint64_t path_hash;
+
+        const autoware_auto_perception_msgs::msg::PredictedObject& Predicted() const {
+            return source->objects[source_index];
+        }
+    };
+
+    /* object table as seen by the services and the publish thread,
+     * published by the ingestion callbacks after every change
+     */
+    struct Snapshot {
+        struct Entry {
+            unique_identifier_msgs::msg::UUID object_id;
+            double collision_point;
+            double collision_prob;
+            int collision_path_index;
+            autoware_auto_perception_msgs::msg::PredictedObjects::ConstSharedPtr source;
+            int source_index;
+        };
+        std::vector<Entry> objects;
+        CPUuidTable<int> index; // id -> position in objects
+        double ego_speed = 0.0;
+        uint64_t applied_seq = 0; // last likelihood update contained
+        // visualisation
+        std_msgs::msg::Header objects_header;
+        uint64_t objects_generation = 0;
+        autoware_auto_planning_msgs::msg::Trajectory::ConstSharedPtr trajectory;
+        uint64_t trajectory_generation = 0;
+    };
+
+    struct LikelihoodUpdate {
+        CPUuid uuid;
+        double likelihood;
+        uint64_t seq;
     };
 
 private:
 
-    std::map<std::string, Object> objects_; // id, object
+    CPUuidTable<Object> objects_; // id, object
+    int max_objects_ = 1024;        // capacity of objects_, reserved at construction
+    double object_timeout_ = 0.5;   // [s] object not seen for this long (message time) is dropped
     geometry_msgs::msg::Pose ego_pose_;
     geometry_msgs::msg::Twist ego_speed_;
-    autoware_auto_planning_msgs::msg::Trajectory ego_trajectory_;
+    // ego speed of the last snapshot, a twist only publishes a new one when the speed moved further
+    double published_ego_speed_ = 0.0;
+    double speed_publish_threshold_ = 0.1; // [m/s]
+    autoware_auto_planning_msgs::msg::Trajectory::ConstSharedPtr ego_trajectory_;
+    // grid and arc length of ego_trajectory_, rebuilt in EgoTrajectoryCb
+    CPTrajectoryIndex trajectory_index_;
+    // bumped when the trajectory changes, objects computed against an older one are re-evaluated
+    uint64_t trajectory_generation_ = 0;
+    uint64_t trajectory_hash_ = 0;
+    double path_hash_resolution_ = 0.1; // [m] path or trajectory movement below this does not trigger a re-evaluation
+    // ObjectsCb and VisualizationCb split their loops over this many threads (clipped to the hardware concurrency)
+    int num_object_workers_ = 4;
+    int min_objects_per_worker_ = 16; // smaller batches run on the callback thread
+
+    // visualisation (rclUE) is published by its own timer and only with subscribers
+    double visualization_period_ = 0.1; // [s]
+    std_msgs::msg::Header objects_header_;
+    uint64_t objects_generation_ = 0;               // ingestion side, bumped when objects or likelihoods change
+    uint64_t visualized_objects_generation_ = 0;    // publish side
+    uint64_t visualized_trajectory_generation_ = 0; // publish side
+
+    // per entry buffers of ObjectsCb, kept to reuse their capacity
+    std::vector<int> batch_targets_;
+    std::vector<int> batch_last_entry_;
+    std::vector<uint8_t> batch_is_new_;
+    std::vector<uint8_t> batch_is_evaluated_;
+    std::vector<double> trajectory_xs_;
+    std::vector<double> trajectory_ys_;
+
+    // ingestion (objects, ego), services (planner requests, intervention result) and publish (visualisation)
+    rclcpp::CallbackGroup::SharedPtr ingestion_group_;
+    rclcpp::CallbackGroup::SharedPtr service_group_;
+    rclcpp::CallbackGroup::SharedPtr publish_group_;
+    // ingestion -> services / publish thread, read without locks
+    CPSnapshot<Snapshot> snapshot_;
+    CPSnapshot<Snapshot> vis_snapshot_;
+    // services -> ingestion
+    CPSpscQueue<LikelihoodUpdate> likelihood_queue_;
+    // services side: queued likelihoods not in the snapshot yet
+    CPUuidTable<LikelihoodUpdate> pending_likelihood_;
+    uint64_t likelihood_seq_ = 0;
+    // ingestion side: seq of the last applied likelihood
+    uint64_t applied_likelihood_seq_ = 0;
+    // held only while a planner state is built and published
+    std::mutex planner_state_mutex_;
+    double collision_thres_ = 3.0; // [m] object path closer than this crosses the trajectory
     cooperative_perception::msg::CPIntervention intervention_result_;
 
 private:
@@ -50,23 +150,50 @@ private:
 
     rclcpp::Publisher<cooperative_perception::msg::CPIntervention>::SharedPtr pub_intervention_;
     rclcpp::Publisher<autoware_auto_perception_msgs::msg::PredictedObjects>::SharedPtr pub_objects_;
-    rclcpp::Publisher<cooperative_perception::msg::CPPredictedObject>::SharedPtr pub_cp_object_;
+    rclcpp::Publisher<cooperative_perception::msg::CPPredictedObjectArray>::SharedPtr pub_cp_objects_;
     rclcpp::Publisher<nav_msgs::msg::Path>::SharedPtr pub_trajectory_;
+    rclcpp::Publisher<cooperative_perception::msg::CPPlannerState>::SharedPtr pub_planner_state_;
+
+    rclcpp::TimerBase::SharedPtr visualization_timer_;
 
     rclcpp::Service<cooperative_perception::srv::Intervention>::SharedPtr intervention_service_;
     rclcpp::Service<cooperative_perception::srv::State>::SharedPtr current_state_service_;
     rclcpp::Service<cooperative_perception::srv::UpdatePerception>::SharedPtr update_perception_service_;
+    rclcpp::Service<cooperative_perception::srv::PlannerTick>::SharedPtr planner_tick_service_;
 
 private:
     void EgoPoseCb(const geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msg); 
     void EgoSpeedCb(const geometry_msgs::msg::TwistWithCovarianceStamped::SharedPtr msg); 
-    void EgoTrajectoryCb(const autoware_auto_planning_msgs::msg::Trajectory::SharedPtr msg);
+    void EgoTrajectoryCb(const autoware_auto_planning_msgs::msg::Trajectory::ConstSharedPtr msg);
     void InterventionCb(const cooperative_perception::msg::CPIntervention::SharedPtr msg);
-    void ObjectsCb(const autoware_auto_perception_msgs::msg::PredictedObjects::SharedPtr msg);
+    void ObjectsCb(const autoware_auto_perception_msgs::msg::PredictedObjects::ConstSharedPtr msg);
+    void VisualizationCb();
 
     void InterventionService(const std::shared_ptr<cooperative_perception::srv::Intervention::Request> request, std::shared_ptr<cooperative_perception::srv::Intervention::Response> response);
     void CurrentStateService(const std::shared_ptr<cooperative_perception::srv::State::Request> request, std::shared_ptr<cooperative_perception::srv::State::Response> response);
-    void GetCollisionPointAndRisk(const autoware_auto_planning_msgs::msg::Trajectory &ego_traj, const autoware_auto_perception_msgs::msg::PredictedObjectKinematics &obj_kinematics, double &collision_prob, double &collision_point, int &path_index) const;
+    void GetCollisionPointAndRisk(const autoware_auto_perception_msgs::msg::PredictedObjectKinematics &obj_kinematics, double &collision_prob, double &collision_arc, int &path_index) const;
+    uint64_t HashPredictedPaths(const autoware_auto_perception_msgs::msg::PredictedObjectKinematics &obj_kinematics) const;
+    uint64_t HashTrajectory(const autoware_auto_planning_msgs::msg::Trajectory &trajectory) const;
     void UpdatePerceptionService(const std::shared_ptr<cooperative_perception::srv::UpdatePerception::Request> request, std::shared_ptr<cooperative_perception::srv::UpdatePerception::Response> response);
+    void PlannerTickService(const std::shared_ptr<cooperative_perception::srv::PlannerTick::Request> request, std::shared_ptr<cooperative_perception::srv::PlannerTick::Response> response);
 
+    void SendIntervention(const unique_identifier_msgs::msg::UUID &object_id);
+    bool SetLikelihood(const unique_identifier_msgs::msg::UUID &object_id, const double likelihood);
+    const Snapshot& ReadSnapshot();
+    void PublishPlannerState();
+    void ApplyLikelihoodUpdates();
+    void PublishSnapshot();
+    void StartThreads();
+    void ParallelFor(CPWorkerPool &pool, const int num, const std::function<void(const int)> &func) const;
+    void GetState(const Snapshot &snapshot, const CPUuidTable<LikelihoodUpdate> *pending, std::vector<unique_identifier_msgs::msg::UUID> &ids, double &ego_speed, std::vector<int> &distances, std::vector<double> &probs, std::vector<std_msgs::msg::String> &types) const;
+
+
+private:
+    // workers of ParallelFor of the ingestion and the publish group, with the setting of the group
+    CPWorkerPool ingestion_pool_;
+    CPWorkerPool publish_pool_;
+    // declared last, so they are stopped before the members their callbacks use go away
+    CPExecutorThread ingestion_thread_;
+    CPExecutorThread service_thread_;
+    CPExecutorThread publish_thread_;
 };
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include "despot/util/random.h"
+#include "cooperative_perception/cp_world_base.hpp"
+#include "cooperative_perception/cp_pomdp.hpp"
+#include "cooperative_perception/operator_model.hpp"
+#include "cooperative_perception/vehicle_model.hpp"
+
+
+using namespace despot;
+
+/* scenario of an offline episode, as in config/param_*.json */
+struct CPSimConfig {
+    double delta_t = 1.0;
+    double time_per_move = 1.0;
+    std::vector<double> risk_likelihood; // likelihood of the automated system, hidden risk is sampled from it
+    std::vector<int> risk_pose;
+    std::vector<std::string> risk_type;  // operator performance of each target, "hard" if not given
+
+    static bool Load(const std::string &path, CPSimConfig &config);
+};
+
+
+/* headless world for offline episodes, no ROS.
+ * the hidden risk of every target is sampled at Initialize, the operator answers
+ * interventions with OperatorModel::ExecIntervention and the ego drives with
+ * VehicleModel::GetTransition on its recognition, one delta_t per step.
+ * poses are measured from the start of the episode, like the particles of CPPOMDP.
+ */
+class CPSimWorld: public CPWorldBase {
+private:
+    CPSimConfig config_;
+    int planning_horizon_;
+    double risk_thresh_;
+
+    // true state (risk_bin is hidden) and the state given to the planner
+    CPState* true_state_;
+    CPState* cp_state_;
+    CPScenario* cp_scenario_;
+    CPValues* cp_values_;
+    // likelihood of the automated system, replaced by the posterior of UpdatePerception
+    std::vector<double> likelihood_;
+    bool is_target_changed_ = true;
+
+    // ground truth models, separate from the planner
+    VehicleModel* vehicle_model_;
+    OperatorModel* operator_model_;
+    CPPOMDP* reward_model_;
+    Random random_;
+
+    double step_reward_ = 0.0;
+
+public:
+    CPSimWorld (const CPSimConfig &config, const unsigned seed, const int planning_horizon = 150, const double risk_thresh = 0.5);
+    ~CPSimWorld ();
+    bool Connect ();
+    State* Initialize ();
+    State* GetCurrentState ();
+    State* GetCurrentState (std::vector<double> &likelihood_list, const double risk_thresh);
+    const CPScenario* GetCurrentScenario () const;
+    bool ExecuteAction (ACT_TYPE action, OBS_TYPE &obs);
+    bool CPExecuteAction (ACT_TYPE &action, OBS_TYPE &obs);
+    void UpdatePerception (const ACT_TYPE &action, const OBS_TYPE &obs, const std::vector<double> &risk_probs);
+    bool IsTargetChanged () const;
+
+    const CPSimConfig& Config () const;
+    /* reward of the last ExecuteAction (CPPOMDP::CalcReward on the true state) */
+    double StepReward () const;
+    const CPState* TrueState () const;
+};
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+/* latest-value cache between one writer thread and one reader thread (triple buffer).
+ * the writer fills Back() and calls Publish(), the reader calls Update() and reads Front().
+ * neither side blocks or allocates, and the reader always sees a complete value.
+ */
+template <class T>
+class CPSnapshot {
+public:
+    /* writer */
+    T& Back() {
+        return buffers_[back_];
+    }
+
+    void Publish() {
+        uint8_t prev = middle_.exchange(back_ | FRESH_BIT, std::memory_order_acq_rel);
+        back_ = prev & INDEX_MASK;
+    }
+
+    /* reader: take the latest published value, false if nothing new was published */
+    bool Update() {
+        if ((middle_.load(std::memory_order_relaxed) & FRESH_BIT) == 0) return false;
+        uint8_t prev = middle_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & INDEX_MASK;
+        has_value_ = true;
+        return true;
+    }
+
+    const T& Front() const {
+        return buffers_[front_];
+    }
+
+    bool HasValue() const {
+        return has_value_;
+    }
+
+private:
+    static constexpr uint8_t INDEX_MASK = 0x3;
+    static constexpr uint8_t FRESH_BIT = 0x4;
+
+    T buffers_[3];
+    uint8_t back_ = 0;                  // writer only
+    uint8_t front_ = 1;                 // reader only
+    bool has_value_ = false;            // reader only
+    std::atomic<uint8_t> middle_{2};
+};
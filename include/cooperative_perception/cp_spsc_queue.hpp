@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/* bounded queue between one producer thread and one consumer thread.
+ * Push and Pop never block or allocate, Push fails when the queue is full.
+ */
+template <class T>
+class CPSpscQueue {
+public:
+    /* capacity is rounded up to a power of two */
+    explicit CPSpscQueue(const size_t capacity = 1024) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    /* producer */
+    bool Push(const T &value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) return false;
+        buffer_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer */
+    bool Pop(T &value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) return false;
+        value = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    // head and tail on their own cache lines, each is written by one side only
+    alignas(64) std::atomic<size_t> head_{0};
+    alignas(64) std::atomic<size_t> tail_{0};
+};
@@ -0,0 +1,193 @@
+#pragma once
+#include "rclcpp/rclcpp.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* scheduling of a thread owned by the nodes, read from the parameters
+ *   <name>.priority     : 0 -> default scheduling, 1..99 -> SCHED_FIFO with this priority
+ *   <name>.cpu_affinity : cores the thread may run on, empty or [-1] -> any core
+ * threads started from a configured thread (object workers, search workers) inherit both.
+ */
+struct CPThreadConfig {
+    std::string name;
+    int priority = 0;
+    std::vector<int64_t> cpu_affinity;
+
+    static CPThreadConfig Declare(rclcpp::Node *node, const std::string &name) {
+        CPThreadConfig config;
+        config.name = name;
+        config.priority = node->declare_parameter<int>(name + ".priority", 0);
+        config.cpu_affinity = node->declare_parameter<std::vector<int64_t>>(name + ".cpu_affinity", std::vector<int64_t>());
+        return config;
+    }
+
+    /* apply to the calling thread, false if the system refused (SCHED_FIFO needs CAP_SYS_NICE / rtprio limits) */
+    bool Apply() const {
+        bool is_ok = true;
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (const auto &cpu : cpu_affinity) {
+            if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpu_set);
+        }
+        if (CPU_COUNT(&cpu_set) > 0) {
+            int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+            if (err != 0) {
+                std::cout << "[cp_thread::Apply] " << name << ": failed to set cpu affinity: " << std::strerror(err) << std::endl;
+                is_ok = false;
+            }
+        }
+
+        if (priority > 0) {
+            sched_param param;
+            param.sched_priority = priority;
+            int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+            if (err != 0) {
+                std::cout << "[cp_thread::Apply] " << name << ": failed to set SCHED_FIFO priority " << priority << ": " << std::strerror(err) << std::endl;
+                is_ok = false;
+            }
+        }
+
+        if (is_ok && (priority > 0 || CPU_COUNT(&cpu_set) > 0)) {
+            std::cout << "[cp_thread::Apply] " << name << ": priority " << priority << " cpus " << CPU_COUNT(&cpu_set) << std::endl;
+        }
+        return is_ok;
+    }
+};
+
+
+/* one callback group spun by its own executor on a configured thread.
+ * the group must be created with automatically_add_to_executor_with_node = false.
+ */
+class CPExecutorThread {
+public:
+    ~CPExecutorThread() {
+        Stop();
+    }
+
+    void Start(rclcpp::CallbackGroup::SharedPtr group, rclcpp::node_interfaces::NodeBaseInterface::SharedPtr node_base, const CPThreadConfig &config) {
+        executor_ = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+        executor_->add_callback_group(group, node_base);
+        is_running_ = true;
+        thread_ = std::thread([this, config]() {
+            config.Apply();
+            /* spin_once in a loop, a cancel before the thread got here would be lost by spin() */
+            while (is_running_ && rclcpp::ok()) {
+                executor_->spin_once(std::chrono::milliseconds(100));
+            }
+        });
+    }
+
+    void Stop() {
+        is_running_ = false;
+        if (executor_ != nullptr) {
+            executor_->cancel();
+        }
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+private:
+    rclcpp::executors::SingleThreadedExecutor::SharedPtr executor_;
+    std::thread thread_;
+    std::atomic<bool> is_running_{false};
+};
+
+
+/* threads kept for the parallel loops of one callback group, started once with its setting.
+ * Run splits a loop into tasks, task 0 runs on the caller and the others on the pool threads.
+ * one Run at a time (the group is mutually exclusive).
+ */
+class CPWorkerPool {
+public:
+    ~CPWorkerPool() {
+        Stop();
+    }
+
+    /* num_threads including the caller */
+    void Start(const int num_threads, const CPThreadConfig &config) {
+        for (int t = 1; t < num_threads; ++t) {
+            threads_.emplace_back([this, t, config]() {
+                config.Apply();
+                Work(t);
+            });
+        }
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stopping_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto &thread : threads_) {
+            if (thread.joinable()) thread.join();
+        }
+        threads_.clear();
+    }
+
+    int NumThreads() const {
+        return threads_.size() + 1;
+    }
+
+    /* func(t) for t in [0, num_tasks), num_tasks <= NumThreads(). returns when all are done */
+    void Run(const int num_tasks, const std::function<void(const int)> &func) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            func_ = &func;
+            num_tasks_ = num_tasks;
+            num_pending_ = num_tasks - 1;
+            generation_++;
+        }
+        start_cv_.notify_all();
+
+        func(0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]() { return num_pending_ <= 0; });
+        func_ = nullptr;
+    }
+
+private:
+    void Work(const int t) {
+        uint64_t seen_generation = 0;
+        while (true) {
+            const std::function<void(const int)> *func = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [this, seen_generation]() { return is_stopping_ || generation_ != seen_generation; });
+                if (is_stopping_) return;
+                seen_generation = generation_;
+                if (t >= num_tasks_) continue;
+                func = func_;
+            }
+
+            (*func)(t);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--num_pending_ <= 0) done_cv_.notify_one();
+        }
+    }
+
+private:
+    std::vector<std::thread> threads_;
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    const std::function<void(const int)> *func_ = nullptr;
+    int num_tasks_ = 0;
+    int num_pending_ = 0;
+    uint64_t generation_ = 0;
+    bool is_stopping_ = false;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+/* uniform grid over the points of the ego trajectory.
+ * built once per trajectory, answers "first trajectory point within radius of (x, y)"
+ * by looking at the cells around the query instead of every point.
+ */
+class CPTrajectoryIndex {
+public:
+    /* cell_size should be >= the query radius, so a query only touches the 3x3 neighbouring cells */
+    void Build(const std::vector<double> &xs, const std::vector<double> &ys, const double cell_size) {
+        cell_size_ = cell_size;
+        xs_ = xs;
+        ys_ = ys;
+        cells_.clear();
+        arc_length_.assign(xs_.size(), 0.0);
+
+        for (int i = 0; i < int(xs_.size()); ++i) {
+            if (i > 0) {
+                arc_length_[i] = arc_length_[i-1] + std::hypot(xs_[i] - xs_[i-1], ys_[i] - ys_[i-1]);
+            }
+            cells_[Key(Cell(xs_[i]), Cell(ys_[i]))].emplace_back(i);
+        }
+    }
+
+    /* smallest trajectory index within radius of (x, y), -1 if none.
+     * indices >= limit are ignored, so the caller can stop early once a closer hit is known.
+     */
+    int FirstWithin(const double x, const double y, const double radius, const int limit) const {
+        int best = -1;
+        int64_t cx = Cell(x), cy = Cell(y);
+        for (int64_t dx = -1; dx <= 1; ++dx) {
+            for (int64_t dy = -1; dy <= 1; ++dy) {
+                auto itr = cells_.find(Key(cx + dx, cy + dy));
+                if (itr == cells_.end()) continue;
+                /* indices in a cell are ascending */
+                for (const int i : itr->second) {
+                    if (i >= limit || (best >= 0 && i >= best)) break;
+                    if (std::hypot(x - xs_[i], y - ys_[i]) < radius) {
+                        best = i;
+                        break;
+                    }
+                }
+            }
+        }
+        return best;
+    }
+
+    /* distance along the trajectory from the first point */
+    double ArcLength(const int i) const {
+        return arc_length_[i];
+    }
+
+    int Size() const {
+        return xs_.size();
+    }
+
+    double X(const int i) const {
+        return xs_[i];
+    }
+
+    double Y(const int i) const {
+        return ys_[i];
+    }
+
+private:
+    double cell_size_ = 1.0;
+    std::vector<double> xs_;
+    std::vector<double> ys_;
+    std::vector<double> arc_length_;
+    std::unordered_map<uint64_t, std::vector<int>> cells_;
+
+private:
+    int64_t Cell(const double v) const {
+        return int64_t(std::floor(v / cell_size_));
+    }
+
+    static uint64_t Key(const int64_t cx, const int64_t cy) {
+        return (uint64_t(cx) << 32) ^ (uint64_t(cy) & 0xffffffff);
+    }
+};
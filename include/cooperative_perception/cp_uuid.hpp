@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/* 128 bit object uuid as two words, compared and hashed without building strings */
+struct CPUuid {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    CPUuid() = default;
+
+    explicit CPUuid(const std::array<uint8_t, 16> &uuid) {
+        std::memcpy(&hi, uuid.data(), 8);
+        std::memcpy(&lo, uuid.data() + 8, 8);
+    }
+
+    std::array<uint8_t, 16> ToArray() const {
+        std::array<uint8_t, 16> uuid;
+        std::memcpy(uuid.data(), &hi, 8);
+        std::memcpy(uuid.data() + 8, &lo, 8);
+        return uuid;
+    }
+
+    bool operator==(const CPUuid &other) const {
+        return hi == other.hi && lo == other.lo;
+    }
+
+    bool operator!=(const CPUuid &other) const {
+        return !(*this == other);
+    }
+
+    /* uuids are random already, one multiply-xorshift round spreads both words over the low bits */
+    uint64_t Hash() const {
+        uint64_t h = hi ^ (lo * 0x9e3779b97f4a7c15ULL);
+        h ^= h >> 32;
+        h *= 0xd6e8feb86659fd93ULL;
+        h ^= h >> 32;
+        return h;
+    }
+};
+
+
+/* CPUuid -> V table with open addressing (linear probing).
+ * entries live in dense arrays indexed 0..Size()-1, the probe array only holds their positions,
+ * so lookups do not allocate and iteration is a plain loop over the entries.
+ * positions are stable across Insert (also when the probe array grows),
+ * EraseAt(i) moves the last entry into i.
+ */
+template <class V>
+class CPUuidTable {
+public:
+    int Size() const {
+        return keys_.size();
+    }
+
+    void Clear() {
+        keys_.clear();
+        values_.clear();
+        std::fill(slots_.begin(), slots_.end(), EMPTY);
+    }
+
+    void Reserve(const int num) {
+        keys_.reserve(num);
+        values_.reserve(num);
+        if (int(slots_.size()) < num * 2) Rehash(num * 2);
+    }
+
+    /* position of the entry, -1 if it does not exist */
+    int Find(const CPUuid &key) const {
+        if (slots_.empty()) return -1;
+        for (size_t s = key.Hash() & Mask(); ; s = (s + 1) & Mask()) {
+            if (slots_[s] == EMPTY) return -1;
+            if (keys_[slots_[s]] == key) return slots_[s];
+        }
+    }
+
+    V* Get(const CPUuid &key) {
+        int i = Find(key);
+        return (i < 0) ? nullptr : &values_[i];
+    }
+
+    const V* Get(const CPUuid &key) const {
+        int i = Find(key);
+        return (i < 0) ? nullptr : &values_[i];
+    }
+
+    /* position of the entry, a default constructed value is added if it does not exist */
+    int Insert(const CPUuid &key, bool *is_new = nullptr) {
+        /* keep the load factor <= 0.5 */
+        if ((keys_.size() + 1) * 2 > slots_.size()) Rehash(std::max<size_t>(16, slots_.size() * 2));
+
+        size_t s = key.Hash() & Mask();
+        for (; slots_[s] != EMPTY; s = (s + 1) & Mask()) {
+            if (keys_[slots_[s]] == key) {
+                if (is_new != nullptr) *is_new = false;
+                return slots_[s];
+            }
+        }
+        slots_[s] = keys_.size();
+        keys_.emplace_back(key);
+        values_.emplace_back();
+        if (is_new != nullptr) *is_new = true;
+        return slots_[s];
+    }
+
+    V& operator[](const CPUuid &key) {
+        return values_[Insert(key)];
+    }
+
+    bool Erase(const CPUuid &key) {
+        int i = Find(key);
+        if (i < 0) return false;
+        EraseAt(i);
+        return true;
+    }
+
+    void EraseAt(const int i) {
+        RemoveSlot(SlotOf(i));
+
+        /* move the last entry into the hole */
+        int last = keys_.size() - 1;
+        if (i != last) {
+            slots_[SlotOf(last)] = i;
+            keys_[i] = keys_[last];
+            values_[i] = std::move(values_[last]);
+        }
+        keys_.pop_back();
+        values_.pop_back();
+    }
+
+    const CPUuid& KeyAt(const int i) const {
+        return keys_[i];
+    }
+
+    V& ValueAt(const int i) {
+        return values_[i];
+    }
+
+    const V& ValueAt(const int i) const {
+        return values_[i];
+    }
+
+private:
+    static constexpr int32_t EMPTY = -1;
+    std::vector<CPUuid> keys_;
+    std::vector<V> values_;
+    std::vector<int32_t> slots_; // size is a power of two
+
+private:
+    size_t Mask() const {
+        return slots_.size() - 1;
+    }
+
+    size_t SlotOf(const int i) const {
+        size_t s = keys_[i].Hash() & Mask();
+        while (slots_[s] != i) s = (s + 1) & Mask();
+        return s;
+    }
+
+    /* backward shift deletion, no tombstones */
+    void RemoveSlot(size_t hole) {
+        for (size_t s = (hole + 1) & Mask(); slots_[s] != EMPTY; s = (s + 1) & Mask()) {
+            size_t home = keys_[slots_[s]].Hash() & Mask();
+            /* the entry at s may move to the hole if its home is not in (hole, s] */
+            bool is_between = (hole <= s) ? (hole < home && home <= s) : (hole < home || home <= s);
+            if (is_between) continue;
+            slots_[hole] = slots_[s];
+            hole = s;
+        }
+        slots_[hole] = EMPTY;
+    }
+
+    void Rehash(size_t num_slots) {
+        size_t size = 16;
+        while (size < num_slots) size *= 2;
+        slots_.assign(size, EMPTY);
+        for (int i = 0; i < int(keys_.size()); ++i) {
+            size_t s = keys_[i].Hash() & Mask();
+            while (slots_[s] != EMPTY) s = (s + 1) & Mask();
+            slots_[s] = i;
+        }
+    }
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+/* index of the search worker running on the calling thread.
+ * the main thread is worker 0, CPDESPOT sets the index of its worker threads.
+ * per-worker resources (particle pools, transition caches) are selected with it
+ * so that the workers never share mutable state during the search.
+ */
+class CPWorker {
+public:
+    static int Id() {
+        return Index();
+    }
+
+    static void SetId(const int id) {
+        Index() = id;
+    }
+
+private:
+    static int& Index() {
+        static thread_local int id = 0;
+        return id;
+    }
+};
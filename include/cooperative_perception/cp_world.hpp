@@ -1,50 +1,131 @@
 #pragma once
 #include "rclcpp/rclcpp.hpp"
+#include <array>
 
-#include "despot/interface/world.h"
-#include "cooperative_perception/libgeometry.hpp"
+#include "cooperative_perception/cp_world_base.hpp"
 #include <unique_identifier_msgs/msg/uuid.hpp>
 #include "cooperative_perception/srv/intervention.hpp"
 #include "cooperative_perception/srv/state.hpp"
 #include "cooperative_perception/srv/update_perception.hpp"
+#include "cooperative_perception/srv/planner_tick.hpp"
+#include "cooperative_perception/msg/cp_planner_state.hpp"
+#include "cooperative_perception/cp_snapshot.hpp"
+#include "cooperative_perception/cp_uuid.hpp"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <chrono>
 
 
 using namespace despot;
 
-class CPWorld: public World {
+class CPWorld: public CPWorldBase {
 private:
 
     // store previous state
     CPState* cp_state_;
+    CPScenario* cp_scenario_;
     std::vector<OBS_TYPE> obs_history_;
 
     // act, obs -> target index mapping
     CPValues* cp_values_;
     std::shared_ptr<rclcpp::Node> node_;
+    // node_ is spun by a component container, not by CPWorld
+    bool is_external_node_ = false;
+    // group of the clients and the state subscription on an external node (nullptr: default group)
+    rclcpp::CallbackGroup::SharedPtr callback_group_ = nullptr;
+    // set by the owner of the planning thread, waits for services give up (nullptr: never)
+    const std::atomic<bool>* stop_requested_ = nullptr;
+    bool is_target_changed_ = true;
+    // idx_table_ of the last step, swapped instead of reallocated
+    CPUuidTable<int> prev_idx_table_;
+
+    // state request kept in flight while the planner searches
+    rclcpp::Client<cooperative_perception::srv::State>::SharedFuture state_future_;
+    bool is_state_requested_ = false;
+    double state_request_t_ = 0.0;
+
+    // likelihood pushed by UpdatePerception, overrides the states which do not contain it yet.
+    // once acked, a state of CPRosInterface with applied_seq >= this applied_seq contains it
+    struct PushedLikelihood {
+        double likelihood;
+        int seq;
+        bool is_acked;
+        uint64_t applied_seq;
+    };
+    CPUuidTable<PushedLikelihood> pushed_likelihood_;
+    // response callbacks may run on another thread when the node is spun externally
+    std::mutex pushed_mutex_;
+    int update_seq_ = 0;
+
+    // state returned with the last PlannerTick
+    cooperative_perception::srv::PlannerTick::Response::SharedPtr tick_result_;
+
+    // latest streamed planner state, written by the subscription thread
+    CPSnapshot<cooperative_perception::msg::CPPlannerState> state_snapshot_;
+    rclcpp::Node::SharedPtr state_node_;
+    rclcpp::executors::SingleThreadedExecutor::SharedPtr state_executor_;
+    std::thread state_thread_;
 
 public:
-    // recognition result
-    std::map<int, unique_identifier_msgs::msg::UUID> id_idx_list_;
-    std::vector<unique_identifier_msgs::msg::UUID> req_target_history_;
+    // uuid -> index in id_idx_list_
+    CPUuidTable<int> idx_table_;
+    // node parameters, read in SetupInterfaces
+    // prefetched or streamed state older than this is not used [s] (max_state_age)
+    double max_state_age_ = 1.0;
+    // state, intervention and perception update in one PlannerTick round trip per step (use_tick_service),
+    // otherwise State (prefetched during the search), Intervention and UpdatePerception
+    bool use_tick_service_ = true;
+    // read the state streamed on the planner state topic, services only when it is missing or stale (use_state_topic)
+    bool use_state_topic_ = true;
+    // age of the state used at the last GetCurrentState [s]
+    double state_age_ = 0.0;
 
 public:
     CPWorld ();
     ~CPWorld ();
     State* Initialize ();
     bool Connect(int argc, char* argv[]);
+    bool Connect(rclcpp::Node::SharedPtr node, rclcpp::CallbackGroup::SharedPtr callback_group = nullptr, const std::atomic<bool>* stop_requested = nullptr);
     bool Connect();
     void Step();
     State* GetCurrentState ();
     State* GetCurrentState (std::vector<double> &likelihood_list, const double risk_thresh);
+    const CPScenario* GetCurrentScenario () const;
     bool ExecuteAction (ACT_TYPE action, OBS_TYPE &obs);
     bool CPExecuteAction (ACT_TYPE &action, OBS_TYPE &obs);
     void UpdatePerception (const ACT_TYPE &action, const OBS_TYPE &obs, const std::vector<double> &risk_probs);
+    bool IsTargetChanged () const;
+    void RequestState ();
 
 
 private:
     rclcpp::Client<cooperative_perception::srv::Intervention>::SharedPtr intervention_client_;
     rclcpp::Client<cooperative_perception::srv::State>::SharedPtr current_state_client_;
     rclcpp::Client<cooperative_perception::srv::UpdatePerception>::SharedPtr update_perception_client_;
+    rclcpp::Client<cooperative_perception::srv::PlannerTick>::SharedPtr planner_tick_client_;
+    rclcpp::Subscription<cooperative_perception::msg::CPPlannerState>::SharedPtr sub_planner_state_;
+
+    bool WaitForService (rclcpp::ClientBase::SharedPtr client, const std::string &name);
+    bool IsRunning () const;
+    bool SetupInterfaces ();
+    void PlannerStateCb (cooperative_perception::msg::CPPlannerState::UniquePtr msg);
+    void SendStateRequest ();
+    void ConfirmPushed (const uint64_t applied_seq);
+    double StampAge (const builtin_interfaces::msg::Time &stamp) const;
+    bool SendTick (const bool has_action, const uint8_t action, const unique_identifier_msgs::msg::UUID &object_id);
+
+    /* wait for a service response, spinning node_ unless the container executor does it */
+    template <class FutureT>
+    bool WaitForFuture (FutureT &future) {
+        if (!is_external_node_) {
+            return rclcpp::spin_until_future_complete(node_, future) == rclcpp::FutureReturnCode::SUCCESS;
+        }
+        while (IsRunning()) {
+            if (future.wait_for(std::chrono::milliseconds(100)) == std::future_status::ready) return true;
+        }
+        return false;
+    }
 
 
 }; 
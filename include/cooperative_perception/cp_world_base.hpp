@@ -0,0 +1,38 @@
+#pragma once
+#include <map>
+#include <vector>
+
+#include "despot/interface/world.h"
+#include "cooperative_perception/libgeometry.hpp"
+#include <unique_identifier_msgs/msg/uuid.hpp>
+
+
+using namespace despot;
+
+/* what the planner needs from a world on top of the despot World interface.
+ * CPWorld serves it from CPRosInterface, CPSimWorld from a simulated scenario.
+ */
+class CPWorldBase: public World {
+public:
+    // recognition result
+    std::map<int, unique_identifier_msgs::msg::UUID> id_idx_list_;
+    std::vector<unique_identifier_msgs::msg::UUID> req_target_history_;
+    // current target index -> index at the last step (-1: new target)
+    std::vector<int> prev_idx_list_;
+
+public:
+    virtual ~CPWorldBase () {}
+
+    using World::GetCurrentState;
+    virtual State* GetCurrentState (std::vector<double> &likelihood_list, const double risk_thresh) = 0;
+    virtual const CPScenario* GetCurrentScenario () const = 0;
+    /* action may be replaced by the request the observation answers */
+    virtual bool CPExecuteAction (ACT_TYPE &action, OBS_TYPE &obs) = 0;
+    virtual void UpdatePerception (const ACT_TYPE &action, const OBS_TYPE &obs, const std::vector<double> &risk_probs) = 0;
+    virtual bool IsTargetChanged () const = 0;
+
+    /* prefetch the state of the next step while the planner searches */
+    virtual void RequestState () {}
+    /* end of a planning step */
+    virtual void Step () {}
+};
@@ -1,9 +1,19 @@
 #pragma once
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <math.h>
 #include "despot/interface/pomdp.h"
 
+// max number of targets a CPState/CPScenario can hold (width of the bitmasks)
+#ifndef CP_MAX_TARGETS
+#define CP_MAX_TARGETS 64
+#endif
+static_assert(CP_MAX_TARGETS <= 64, "CPState bitmasks hold at most 64 targets");
+
 namespace despot {
 
 class CPRosTools {
@@ -13,7 +23,7 @@ public:
     {
         std::string out_string = "";
         for (const auto &id : uuid) {
-            out_string += static_cast<int>(id) + "-";
+            out_string += std::to_string(static_cast<int>(id)) + "-";
         }
         return out_string;
     }
@@ -22,53 +32,176 @@ public:
 
 
 
+/* interned perception type names ("easy", "hard", ...) -> dense integer ids
+ * so that particles carry an int instead of a string
+ */
+class CPTypeTable {
+public:
+    static int GetId(const std::string &type) {
+        std::vector<std::string> &names = Names();
+        auto itr = std::find(names.begin(), names.end(), type);
+        if (itr != names.end()) {
+            return std::distance(names.begin(), itr);
+        }
+        names.emplace_back(type);
+        return names.size() - 1;
+    }
+
+    static const std::string& GetName(const int id) {
+        return Names().at(id);
+    }
+
+    static int Size() {
+        return Names().size();
+    }
+
+private:
+    static std::vector<std::string>& Names() {
+        static std::vector<std::string> names;
+        return names;
+    }
+};
+
+
+/* particle of the cooperative perception pomdp.
+ * only the dynamic ego / hidden state is stored, per-target flags are bitmasks
+ * and the static target layout lives in CPScenario, so a copy is a flat memberwise copy.
+ */
 class CPState : public State {
 public:
 	int ego_pose;
     double ego_speed;
-	std::vector<bool> ego_recog;
+	uint64_t ego_recog; // bit i : target i is recognized as risk
 	int req_time;
 	int req_target;
-    std::vector<int> risk_pose;
-    std::vector<std::string> risk_type;
 
 	// hidden state
-	std::vector<bool> risk_bin;
+	uint64_t risk_bin; // bit i : target i is risk
     
     CPState() : State() {
         ego_pose = 0;
         ego_speed = 11.2;
         req_time = 0;
         req_target = 0;
-        ego_recog = std::vector<bool>();
-        risk_pose = std::vector<int>();
-        risk_bin = std::vector<bool>();
-        risk_type = std::vector<std::string>();
+        ClearTargets();
+    }
+
+    bool GetRecog(const int idx) const {
+        return (ego_recog >> idx) & 1ULL;
+    }
+
+    void SetRecog(const int idx, const bool recog) {
+        ego_recog = (recog) ? (ego_recog | (1ULL << idx)) : (ego_recog & ~(1ULL << idx));
     }
 
-    CPState(int _ego_pose, float _ego_speed, std::vector<bool> _ego_recog, int _req_time, int _req_target, std::vector<bool> _risk_bin, std::vector<int> _risk_pose) :
-            ego_pose(_ego_pose),
-            ego_speed(_ego_speed),
-            ego_recog(_ego_recog),
-            req_time(_req_time),
-            req_target(_req_target),
-            risk_pose(_risk_pose),
-            risk_bin(_risk_bin)	{
+    bool GetRisk(const int idx) const {
+        return (risk_bin >> idx) & 1ULL;
     }
 
-    ~CPState() {
+    void SetRisk(const int idx, const bool risk) {
+        risk_bin = (risk) ? (risk_bin | (1ULL << idx)) : (risk_bin & ~(1ULL << idx));
+    }
+
+    void ClearTargets() {
+        ego_recog = 0;
+        risk_bin = 0;
     }
 
     std::string text() const {
-        return "ego_pose: " + to_string(ego_pose) + "\n" + 
-               "ego_speed: " + to_string(ego_speed) + "\n" + 
-               "ego_recog: " + to_string(ego_recog) + "\n" +
-               "req_time: " + to_string(req_time) + "\n" +
-               "req_target: " + to_string(req_target) + "\n" +
-               "risk_pose: " + to_string(risk_pose) + "\n" +
-               "risk_bin: " + to_string(risk_bin) + "\n" + 
-               "risk_type: " + to_string(risk_type) + "\n";
-        // return "";
+        std::stringstream ss;
+        ss << "ego_pose: " << ego_pose << "\n"
+           << "ego_speed: " << ego_speed << "\n"
+           << "ego_recog: 0x" << std::hex << ego_recog << std::dec << "\n"
+           << "req_time: " << req_time << "\n"
+           << "req_target: " << req_target << "\n"
+           << "risk_bin: 0x" << std::hex << risk_bin << std::dec << "\n";
+        return ss.str();
+    }
+
+    static std::string MaskText(const uint64_t mask, const int num_targets) {
+        std::string out = "[";
+        for (int i = 0; i < num_targets; i++) {
+            out += ((i == 0) ? "" : ", ") + std::to_string((mask >> i) & 1ULL);
+        }
+        return out + "]";
+    }
+};
+
+
+/* static target layout of one planning step, shared by every particle of the step.
+ * owned by CPPOMDP, read only during the search.
+ */
+class CPScenario {
+public:
+    int num_targets = 0;
+    std::vector<int> risk_pose;
+    std::vector<int> risk_type;   // CPTypeTable id
+    std::vector<int> sorted_idx;  // target index in ascending order of risk_pose
+
+    // operator accuracy of each target at req_time = 0 .. max_req_time
+    int max_req_time = 0;
+    std::vector<double> acc_curve;
+
+    // new for every change of the targets (Clear, AddTarget), kept by copies.
+    // caches of the layout (VehicleModel transitions) are keyed on it, 0: never set up
+    uint64_t layout_id = 0;
+
+public:
+    static uint64_t NextLayoutId() {
+        static std::atomic<uint64_t> next_id{0};
+        return ++next_id;
+    }
+
+    void Clear() {
+        layout_id = NextLayoutId();
+        num_targets = 0;
+        risk_pose.clear();
+        risk_type.clear();
+        sorted_idx.clear();
+        acc_curve.clear();
+        max_req_time = 0;
+    }
+
+    bool AddTarget(const int pose, const int type) {
+        if (num_targets >= CP_MAX_TARGETS) {
+            std::cerr << "[CPScenario] exceeded max target num: " << CP_MAX_TARGETS << std::endl;
+            return false;
+        }
+        risk_pose.emplace_back(pose);
+        risk_type.emplace_back(type);
+        num_targets++;
+        layout_id = NextLayoutId();
+        return true;
+    }
+
+    void SortTargets() {
+        sorted_idx.resize(num_targets);
+        for (int i = 0; i < num_targets; i++) {
+            sorted_idx[i] = i;
+        }
+        std::stable_sort(sorted_idx.begin(), sorted_idx.end(), [this](int a, int b) {
+            return risk_pose[a] < risk_pose[b];
+        });
+    }
+
+    double Accuracy(const int target, const int req_time) const {
+        int time = (req_time < max_req_time) ? req_time : max_req_time;
+        return acc_curve[target * (max_req_time + 1) + time];
+    }
+
+    std::string text() const {
+        std::stringstream ss;
+        ss << "risk_pose: [";
+        for (int i = 0; i < num_targets; i++) {
+            ss << ((i == 0) ? "" : ", ") << risk_pose[i];
+        }
+        ss << "]\n"
+           << "risk_type: [";
+        for (int i = 0; i < num_targets; i++) {
+            ss << ((i == 0) ? "" : ", ") << CPTypeTable::GetName(risk_type[i]);
+        }
+        ss << "]\n";
+        return ss.str();
     }
 };
 
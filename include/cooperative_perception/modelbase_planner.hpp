@@ -5,7 +5,7 @@
 #include "cooperative_perception/vehicle_model.hpp"
 #include "cooperative_perception/operator_model.hpp"
 #include "cooperative_perception/cp_pomdp.hpp"
-#include "cooperative_perception/cp_world.hpp"
+#include "cooperative_perception/cp_world_base.hpp"
 #include "cooperative_perception/libgeometry.hpp"
 #include "unique_identifier_msgs/msg/uuid.hpp"
 
@@ -17,6 +17,7 @@ class ModelbasePlanner: public Solver
         VehicleModel *vehicle_model_;
         OperatorModel *operator_model_;
         CPState *cp_state_;
+        const CPScenario *cp_scenario_;
         CPValues *cp_values_;
 
     public:
@@ -37,9 +38,10 @@ class MyopicModel: public ModelbasePlanner
         {
             vehicle_model_ = vehicle_model;
             operator_model_ = operator_model;
-            CPWorld *cp_world = static_cast<CPWorld*>(world);
+            CPWorldBase *cp_world = static_cast<CPWorldBase*>(world);
             cp_state_ = static_cast<CPState*>(cp_world->GetCurrentState());
-            cp_values_ = new CPValues(cp_state_->risk_pose.size());
+            cp_scenario_ = cp_world->GetCurrentScenario();
+            cp_values_ = new CPValues(cp_scenario_->num_targets);
             req_target_history_ = cp_world->req_target_history_;
             id_idx_list_ = cp_world->id_idx_list_;
         }
@@ -51,9 +53,10 @@ class NoRequestModel: public ModelbasePlanner
         NoRequestModel(const DSPOMDP* model, Belief* belief, World* world)
         : ModelbasePlanner(model, belief) 
         {
-            CPWorld *cp_world = static_cast<CPWorld*>(world);
+            CPWorldBase *cp_world = static_cast<CPWorldBase*>(world);
             cp_state_ = static_cast<CPState*>(world->GetCurrentState());
-            cp_values_ = new CPValues(cp_state_->risk_pose.size());
+            cp_scenario_ = cp_world->GetCurrentScenario();
+            cp_values_ = new CPValues(cp_scenario_->num_targets);
         }
         despot::ValuedAction Search();
 };
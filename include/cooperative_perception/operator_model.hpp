@@ -14,13 +14,22 @@ public:
         {"future", {1.0, 0.65, 0.03, 0.8, 0.9, 0.1}},
     };
 
+    /* compiled accuracy table, [CPTypeTable id * (max_time_ + 1) + time]
+     * built from performance_ once, so that the search does not touch strings */
+    int max_time_ = 150;
+    int num_types_ = 0;
+    std::vector<double> acc_table_;
+
 public:
     OperatorModel();
     OperatorModel(const std::map<std::string, PerceptionPerformance> &perception_performance);
     ~OperatorModel();
 	
-    double InterventionAccuracy(const int time, const std::string type) const;
-    int ExecIntervention(const int time, const bool risk, const std::string type) const;
-    int ExecIntervention(const int time, const bool risk, const double rand_num, const std::string type) const;
+    void CompileAccuracyTable(const int max_time);
+    double InterventionAccuracy(const int time, const std::string &type) const;
+    double InterventionAccuracy(const int time, const int type_id) const;
+    int ExecIntervention(const int time, const bool risk, const std::string &type) const;
+    int ExecIntervention(const int time, const bool risk, const double rand_num, const std::string &type) const;
+    int ExecIntervention(const int time, const bool risk, const double rand_num, const double acc) const;
     
 };
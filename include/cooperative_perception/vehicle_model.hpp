@@ -3,6 +3,42 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include "cooperative_perception/cp_worker.hpp"
+
+/* memoized GetTransition result, valid for one target layout */
+struct TransitionKey {
+    long speed;      // speed / cache_speed_res_
+    int pose;
+    uint64_t recog_mask;
+
+    bool operator==(const TransitionKey &other) const {
+        return speed == other.speed && pose == other.pose && recog_mask == other.recog_mask;
+    }
+};
+
+struct TransitionKeyHash {
+    size_t operator()(const TransitionKey &key) const {
+        uint64_t h = key.recog_mask * 0x9e3779b97f4a7c15ULL;
+        h ^= (static_cast<uint64_t>(key.speed) << 32) ^ static_cast<uint32_t>(key.pose);
+        h ^= h >> 29;
+        return h * 0xbf58476d1ce4e5b9ULL;
+    }
+};
+
+struct TransitionValue {
+    double speed;
+    int pose;
+};
+
+/* transition cache of one search worker */
+struct TransitionCache {
+    std::unordered_map<TransitionKey, TransitionValue, TransitionKeyHash> table;
+    uint64_t hit = 0;
+    uint64_t miss = 0;
+};
 
 class VehicleModel {
 public:
@@ -14,6 +50,17 @@ public:
     int safety_margin_;
     double delta_t_;
 
+    // transition cache
+    bool use_transition_cache_ = true;
+    double cache_speed_res_ = 0.001;
+    size_t max_cache_size_ = 1 << 20;
+
+private:
+    // one cache per search worker (CPWorker::Id), so the lookup needs no lock
+    mutable std::vector<TransitionCache> transition_caches_ = std::vector<TransitionCache>(1);
+    // CPScenario::layout_id the caches were set up for
+    uint64_t cache_layout_id_ = 0;
+
 public:
     VehicleModel(); 
     VehicleModel(const double delta_t);
@@ -21,9 +68,13 @@ public:
     double GetDecelDistance(const double speed, const double acc, const double safety_margin) const;
     double GetDecelTime(const double speed, const double acc) const;
 
-    double GetAccel(const double speed, const int pose, const std::vector<bool>& recog_list, const std::vector<int>& target_poses) const;
+    double GetAccel(const double speed, const int pose, const uint64_t recog_mask, const int* target_poses, const int* sorted_idx, const int num_targets) const;
 
     double ClipSpeed(const double acc, const double v0) const;
 
-    void GetTransition(double& speed, int& pose, const std::vector<bool>& recog_list, const std::vector<int>& target_poses) const; 
+    void GetTransition(double& speed, int& pose, const uint64_t recog_mask, const int* target_poses, const int* sorted_idx, const int num_targets, const uint64_t layout_id = 0) const; 
+
+    void ResetTransitionCache(const uint64_t layout_id);
+    void SetNumWorkers(const int num_workers);
+    void PrintCacheStats(std::ostream& out = std::cout) const;
 };
@@ -0,0 +1,62 @@
+from launch import LaunchDescription
+from launch_ros.actions import ComposableNodeContainer
+from launch_ros.descriptions import ComposableNode
+
+
+def generate_launch_description():
+    # interface and planner share one process, messages are passed by pointer
+    container = ComposableNodeContainer(
+        name='cooperative_perception_container',
+        namespace='',
+        package='rclcpp_components',
+        executable='component_container_mt',
+        composable_node_descriptions=[
+            ComposableNode(
+                package='cooperative_perception',
+                plugin='CPRosInterface',
+                name='cp_ros_interface',
+                # <group>.priority: 0 default scheduling, 1..99 SCHED_FIFO (needs CAP_SYS_NICE)
+                # <group>.cpu_affinity: cores of the thread, empty for any core
+                parameters=[{
+                    'ingestion.priority': 0,
+                    'ingestion.cpu_affinity': [-1],
+                    'service.priority': 0,
+                    'service.cpu_affinity': [-1],
+                    'publish.priority': 0,
+                    'publish.cpu_affinity': [-1],
+                }],
+                extra_arguments=[{'use_intra_process_comms': True}],
+            ),
+            ComposableNode(
+                package='cooperative_perception',
+                plugin='CPPlannerNode',
+                name='cooperative_perception',
+                parameters=[{
+                    # keep the DESPOT tree across steps while the observation agrees with it
+                    'persistent_planner': False,
+                    'search_workers': 8,
+                    # hit rate of the VehicleModel transition cache after every search
+                    'print_cache_stats': False,
+                    # one PlannerTick per step, or State (prefetched) + Intervention + UpdatePerception
+                    'use_tick_service': True,
+                    # state streamed by cp_ros_interface, the services only when it is stale
+                    'use_state_topic': True,
+                    'max_state_age': 1.0,
+                    'planner.priority': 0,
+                    'planner.cpu_affinity': [-1],
+                    'planner_io.priority': 0,
+                    'planner_io.cpu_affinity': [-1],
+                }],
+                remappings=[
+                    ('/intervention', '/cooperative_perception/intervention'),
+                    ('/cp_current_state', '/cooperative_perception/cp_current_state'),
+                    ('/cp_updated_target', '/cooperative_perception/cp_updated_target'),
+                    ('/cp_planner_tick', '/cooperative_perception/cp_planner_tick'),
+                ],
+                extra_arguments=[{'use_intra_process_comms': True}],
+            ),
+        ],
+        output='screen',
+    )
+
+    return LaunchDescription([container])
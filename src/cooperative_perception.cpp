@@ -4,10 +4,19 @@ CooperativePerception::CooperativePerception()
 {
 }
 
+CooperativePerception::CooperativePerception(rclcpp::Node::SharedPtr node, rclcpp::CallbackGroup::SharedPtr callback_group, const std::atomic<bool>* stop_requested)
+    : node_(node), callback_group_(callback_group), stop_requested_(stop_requested)
+{
+    persistent_planner_ = node_->declare_parameter<bool>("persistent_planner", persistent_planner_);
+    num_search_workers_ = node_->declare_parameter<int>("search_workers", num_search_workers_);
+    print_cache_stats_ = node_->declare_parameter<bool>("print_cache_stats", print_cache_stats_);
+}
+
 int CooperativePerception::RunPlanning(int argc, char* argv[]) 
 {
     // models
     operator_model_ = new OperatorModel();
+    operator_model_->CompileAccuracyTable(planning_horizon_);
     vehicle_model_ = new VehicleModel(delta_t_);
 
     bool search_solver;
@@ -49,10 +58,61 @@ int CooperativePerception::RunPlanning(int argc, char* argv[])
     return 0;
 }
 
+/* one episode against a simulated world, no ROS and no despot logger (cp_evaluation).
+ * Globals::config (time_per_move, sim_len, discount) is read as set by the caller.
+ * returns the number of steps.
+ */
+int CooperativePerception::RunEpisode(CPSimWorld* world, const std::string &policy_type, const bool persistent_planner, const int num_search_workers, double &discounted_reward, double &undiscounted_reward)
+{
+    policy_type_ = policy_type;
+    persistent_planner_ = persistent_planner;
+    num_search_workers_ = num_search_workers;
+    delta_t_ = world->Config().delta_t;
+
+    // models
+    operator_model_ = new OperatorModel();
+    operator_model_->CompileAccuracyTable(planning_horizon_);
+    vehicle_model_ = new VehicleModel(delta_t_);
+
+    world->Connect();
+    world->Initialize();
+
+    Solver *solver = nullptr;
+    discounted_reward = 0.0;
+    undiscounted_reward = 0.0;
+    bool terminal = false;
+    for (step_ = 0; !terminal && step_ < Globals::config.sim_len; step_++) {
+        terminal = RunStep(solver, world, nullptr, nullptr);
+        discounted_reward += std::pow(Globals::config.discount, step_) * world->StepReward();
+        undiscounted_reward += world->StepReward();
+    }
+    return step_;
+}
+
 Solver* CooperativePerception::CPInitializeSolver(DSPOMDP *model, Belief *belief, World *world)
 {
-    if (policy_type_ == "DESPOT") {
-        Solver *solver = InitializeSolver(model, belief, policy_type_, options_);
+    if (policy_type_ == "DESPOT" && persistent_planner_) {
+        CPDESPOT *solver = new CPDESPOT(model,
+                                        model->CreateScenarioLowerBound("DEFAULT", "DEFAULT"),
+                                        model->CreateScenarioUpperBound("DEFAULT", "DEFAULT"),
+                                        belief,
+                                        num_search_workers_);
+        static_cast<CPPOMDP*>(model)->SetNumWorkers(solver->NumWorkers());
+        std::cout << "[cooperative_perception::CPInitializeSolver] initialize persistent solver" << std::endl;
+        return solver;
+
+    } else if (policy_type_ == "DESPOT") {
+        /* without a command line (RunEpisode) the bounds are the defaults of the model */
+        Solver *solver = nullptr;
+        if (options_ != nullptr) {
+            solver = InitializeSolver(model, belief, policy_type_, options_);
+        }
+        else {
+            solver = new DESPOT(model,
+                                model->CreateScenarioLowerBound("DEFAULT", "DEFAULT"),
+                                model->CreateScenarioUpperBound("DEFAULT", "DEFAULT"),
+                                belief);
+        }
         std::cout << "[cooperative_perception::CPInitializeSolver] initialize solver" << std::endl;
         return solver;
 
@@ -72,24 +132,34 @@ Solver* CooperativePerception::CPInitializeSolver(DSPOMDP *model, Belief *belief
         return solver;
     }
 
+    std::cout << "[cooperative_perception::CPInitializeSolver] unknown policy: " << policy_type_ << std::endl;
+    return nullptr;
 }
 
 
 void CooperativePerception::PlanningLoop(Solver*& solver, World* world, DSPOMDP* model, Logger* logger) 
 {
     bool terminal = false;
-    while (!terminal) {
+    while (!terminal && !IsStopRequested()) {
         terminal = RunStep(solver, world, model, logger);
     }
+    if (IsStopRequested()) {
+        std::cout << "[cooperative_perception::PlanningLoop] stop requested" << std::endl;
+    }
+}
+
+bool CooperativePerception::IsStopRequested() const
+{
+    return stop_requested_ != nullptr && stop_requested_->load();
 }
 
 bool CooperativePerception::RunStep(Solver* solver, World* world, DSPOMDP* model, Logger* logger)
 {
 
-    logger->CheckTargetTime();
+    if (logger != nullptr) logger->CheckTargetTime();
     double step_start_t = get_time_second();
 
-    CPWorld* cp_world = static_cast<CPWorld*>(world);
+    CPWorldBase* cp_world = static_cast<CPWorldBase*>(world);
 
     std::vector<double> likelihood_list;
     State *state = cp_world->GetCurrentState(likelihood_list, risk_thresh_);
@@ -99,28 +169,75 @@ bool CooperativePerception::RunStep(Solver* solver, World* world, DSPOMDP* model
         return true;
     }
     
-    std::cout << "[cooperative_perception::RunStep] curent_state: \n" << state->text() << std::endl;
+    std::cout << "[cooperative_perception::RunStep] curent_state: \n" << state->text() << cp_world->GetCurrentScenario()->text() << std::endl;
+
+    CPPOMDP* cp_model;
+    if (policy_type_ == "DESPOT" && persistent_planner_) {
+        cp_model = UpdatePersistentPlanner(state, likelihood_list, cp_world);
+        solver = persistent_solver_;
+    }
+    else {
+        cp_model = InitializeModel(cp_world->GetCurrentScenario());
 
-    CPPOMDP* cp_model = InitializeModel(state);
+        Belief* belief = cp_model->InitialBelief(state, likelihood_list, belief_type_);
+        assert(belief != NULL);
+        cp_model->PrintBelief(*belief);
+        // solver->belief(belief);
 
-    Belief* belief = cp_model->InitialBelief(state, likelihood_list, belief_type_);
-    assert(belief != NULL);
-    cp_model->PrintBelief(*belief);
-    // solver->belief(belief);
+        solver = CPInitializeSolver(cp_model, belief, cp_world);
+        std::cout << "[cooperative_perception::RunStep] initialized solver" << std::endl;
+    }
+    if (solver == nullptr) {
+        std::cout << "[cooperative_perception::RunStep] no solver for policy " << policy_type_ << std::endl;
+        return true;
+    }
 
-    solver = CPInitializeSolver(cp_model, belief, cp_world);
-    std::cout << "[cooperative_perception::RunStep] initialized solver" << std::endl;
+    /* next state is fetched while searching */
+    cp_world->RequestState();
 
     double start_t = get_time_second();
-    ACT_TYPE action = solver->Search().action;
-    double end_t = get_time_second();
-    double search_time = end_t - start_t;
+    ACT_TYPE action;
+    if (policy_type_ != "DESPOT") {
+        action = solver->Search().action;
+    }
+    else {
+        /* search only as long as the step deadline allows after the observed I/O latency */
+        double budget = GetSearchBudget(step_start_t);
+        bool has_tree = persistent_planner_ && persistent_solver_->HasTree();
+        if (budget < min_search_time_ && !has_tree) {
+            action = FallbackAction(cp_model, solver->belief(), cp_world);
+            std::cout << "[cooperative_perception::RunStep] no time to search, budget: " << budget << " fallback action" << std::endl;
+        }
+        else {
+            if (persistent_planner_) {
+                persistent_solver_->SetDeadline(start_t + std::max(budget, 0.0));
+                action = solver->Search().action;
+            }
+            else {
+                /* despot's DESPOT builds its tree for time_per_move, which the world also reads */
+                double time_per_move = Globals::config.time_per_move;
+                Globals::config.time_per_move = std::min(time_per_move, std::max(budget, 0.0));
+                action = solver->Search().action;
+                Globals::config.time_per_move = time_per_move;
+            }
+            if (action < 0) {
+                action = FallbackAction(cp_model, solver->belief(), cp_world);
+                std::cout << "[cooperative_perception::RunStep] no tree searched in time, fallback action" << std::endl;
+            }
+        }
+        std::cout << "[cooperative_perception::RunStep] search budget: " << budget << std::endl;
+    }
+    double search_end_t = get_time_second();
+    double search_time = search_end_t - start_t;
     std::cout << "[cooperative_perception::RunStep] search completed" << std::endl;
+    if (print_cache_stats_) {
+        vehicle_model_->PrintCacheStats();
+    }
 
     start_t = get_time_second();
     OBS_TYPE obs;
     bool terminal = cp_world->CPExecuteAction(action, obs);
-    end_t = get_time_second();
+    double end_t = get_time_second();
     double execute_time = end_t - start_t;
 
     
@@ -131,19 +248,153 @@ bool CooperativePerception::RunStep(Solver* solver, World* world, DSPOMDP* model
     double update_time = end_t - start_t;
     std::cout << "[cooperative_perception::RunStep] updated belief" << std::endl;
 
-    cp_world->UpdatePerception(action, obs, cp_model->GetPerceptionLikelihood(belief));
+    cp_world->UpdatePerception(action, obs, cp_model->GetPerceptionLikelihood(solver->belief()));
     std::cout << "[cooperative_perception::RunStep] update intervention target" << std::endl;
     cp_world->Step();
 
+    /* everything after the search, as GetSearchBudget reserves it */
+    UpdateLatency(get_time_second() - search_end_t);
+    std::cout << "[cooperative_perception::RunStep] step time: " << get_time_second() - step_start_t 
+              << " search: " << search_time
+              << " execute: " << execute_time
+              << " update: " << update_time 
+              << " estimated post search latency: " << post_search_latency_ << std::endl;
+
+    if (logger == nullptr) return terminal;
     return logger->SummarizeStep(step_++, round_, terminal, action, obs, step_start_t);
 }
 
 
+/* time left for the search in this step.
+ * the time spent since step_start_t (GetCurrentState) and the expected time
+ * of the steps after the search (execute, belief update, perception update) are subtracted.
+ */
+double CooperativePerception::GetSearchBudget(const double step_start_t) const
+{
+    double step_deadline = (step_deadline_ > 0.0) ? step_deadline_ : Globals::config.time_per_move;
+    double elapsed = get_time_second() - step_start_t;
+    return step_deadline - elapsed - post_search_latency_ - deadline_margin_;
+}
+
+
+/* follow a latency burst immediately, decay slowly when it calms down */
+void CooperativePerception::UpdateLatency(const double post_search_time)
+{
+    if (post_search_time > post_search_latency_) {
+        post_search_latency_ = post_search_time;
+    }
+    else {
+        post_search_latency_ = (1.0 - latency_decay_) * post_search_latency_ + latency_decay_ * post_search_time;
+    }
+}
+
+
+/* action of the myopic planner, used when no time is left for the search */
+ACT_TYPE CooperativePerception::FallbackAction(DSPOMDP* model, Belief* belief, World* world)
+{
+    MyopicModel fallback(model, belief, vehicle_model_, operator_model_, world);
+    ACT_TYPE action = fallback.Search().action;
+    delete fallback.cp_values_;
+    return action;
+}
+
+
+/* keep model and solver alive across steps.
+ * the re-rooted tree is searched further as long as the targets are unchanged and the
+ * observation agrees with its particles, otherwise the belief is patched to the new state
+ * and targets and the tree is rebuilt.
+ */
+CPPOMDP* CooperativePerception::UpdatePersistentPlanner(State* state, const std::vector<double>& likelihood_list, CPWorldBase* world)
+{
+    /* first step */
+    if (persistent_model_ == nullptr) {
+        persistent_model_ = InitializeModel(world->GetCurrentScenario());
+        Belief* belief = persistent_model_->InitialBelief(state, likelihood_list, belief_type_);
+        assert(belief != NULL);
+        persistent_solver_ = static_cast<CPDESPOT*>(CPInitializeSolver(persistent_model_, belief, world));
+        std::cout << "[cooperative_perception::UpdatePersistentPlanner] initialized planner" << std::endl;
+        return persistent_model_;
+    }
+
+    /* same targets, re-rooted tree available and the world moved as the tree predicted */
+    if (!world->IsTargetChanged() && persistent_solver_->HasTree() && IsTreeConsistent(state, likelihood_list, world)) {
+        std::cout << "[cooperative_perception::UpdatePersistentPlanner] reuse tree" << std::endl;
+        return persistent_model_;
+    }
+
+    /* targets appeared/disappeared, observation differs from the tree or no subtree to reuse */
+    Belief* prev_belief = persistent_solver_->belief();
+    persistent_model_->SyncTargets(world->GetCurrentScenario());
+    Belief* belief = persistent_model_->PatchBelief(prev_belief, state, likelihood_list, world->prev_idx_list_);
+    persistent_solver_->belief(belief);
+    delete prev_belief;
+    persistent_model_->PrintBelief(*belief);
+    std::cout << "[cooperative_perception::UpdatePersistentPlanner] patched targets" << std::endl;
+
+    return persistent_model_;
+}
+
+
+/* the particles of the re-rooted belief are the prediction of the model, the world may differ:
+ * measured ego speed, distance to the targets (the world re-bases risk_pose on the ego pose
+ * every step, the model keeps the layout of the step it was synced) and perception likelihood.
+ */
+bool CooperativePerception::IsTreeConsistent(const State* state, const std::vector<double>& likelihood_list, const CPWorldBase* world) const
+{
+    const CPState* cp_state = static_cast<const CPState*>(state);
+    const CPScenario* scenario = world->GetCurrentScenario();
+    const CPScenario& model_scenario = persistent_model_->scenario_;
+    const vector<State*>& particles = static_cast<const ParticleBelief*>(persistent_solver_->belief())->particles();
+    if (particles.empty() || scenario->num_targets != model_scenario.num_targets || int(likelihood_list.size()) != scenario->num_targets) {
+        return false;
+    }
+
+    double total_weight = 0.0, speed = 0.0, pose = 0.0;
+    for (const auto particle : particles) {
+        const CPState* p = static_cast<const CPState*>(particle);
+        total_weight += p->weight;
+        speed += p->weight * p->ego_speed;
+        pose += p->weight * p->ego_pose;
+    }
+    if (total_weight <= 0.0) return false;
+    speed /= total_weight;
+    pose /= total_weight;
+
+    if (std::fabs(speed - cp_state->ego_speed) > reuse_speed_tolerance_) {
+        std::cout << "[cooperative_perception::IsTreeConsistent] ego speed " << cp_state->ego_speed << " predicted " << speed << std::endl;
+        return false;
+    }
+
+    for (int i = 0; i < scenario->num_targets; i++) {
+        double predicted = model_scenario.risk_pose[i] - pose;
+        double observed = scenario->risk_pose[i] - cp_state->ego_pose;
+        if (std::fabs(predicted - observed) > reuse_pose_tolerance_) {
+            std::cout << "[cooperative_perception::IsTreeConsistent] distance to target " << i << ": " << observed << " predicted " << predicted << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<double> probs = persistent_model_->GetPerceptionLikelihood(persistent_solver_->belief());
+    for (int i = 0; i < scenario->num_targets; i++) {
+        if (std::fabs(probs[i] - likelihood_list[i]) > reuse_likelihood_tolerance_) {
+            std::cout << "[cooperative_perception::IsTreeConsistent] likelihood of target " << i << ": " << likelihood_list[i] << " belief " << probs[i] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+
 World* CooperativePerception::InitializeWorld(int argc, char* argv[], std::string& world_type, DSPOMDP* model, option::Option* options)
 {
     std::cout << "[cooperative_perception::InitializeWorld] initialize world" << std::endl;
     CPWorld* world = new CPWorld();
-    world->Connect(argc, argv);
+    if (node_ != nullptr) {
+        world->Connect(node_, callback_group_, stop_requested_);
+    }
+    else {
+        world->Connect(argc, argv);
+    }
     world->Initialize();
     world->Step();
     return world;
@@ -171,13 +422,9 @@ DSPOMDP* CooperativePerception::InitializeModel(option::Option* options)
     return new CPPOMDP();
 }
 
-CPPOMDP* CooperativePerception::InitializeModel (State* state)
+CPPOMDP* CooperativePerception::InitializeModel (const CPScenario* scenario)
 {
-    CPPOMDP* model = new CPPOMDP(planning_horizon_, risk_thresh_, delta_t_, vehicle_model_, operator_model_, state);
+    CPPOMDP* model = new CPPOMDP(planning_horizon_, risk_thresh_, delta_t_, vehicle_model_, operator_model_, scenario);
     return model;
 }
 
-int main(int argc, char ** argv)
-{
-    return CooperativePerception().RunPlanning(argc, argv);
-}
@@ -0,0 +1,267 @@
+#include "cooperative_perception/cp_despot.hpp"
+
+#include <climits>
+#include <thread>
+
+using namespace std;
+
+namespace despot {
+
+CPDESPOT::CPDESPOT(const DSPOMDP* model, ScenarioLowerBound* lb, ScenarioUpperBound* ub, Belief* belief, const int num_workers)
+    : DESPOT(model, lb, ub, belief),
+      is_reused_(false),
+      search_depth_(Globals::config.search_depth),
+      max_root_depth_(Globals::config.search_depth)
+{
+    root_ = NULL;
+
+    int max_workers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    int num = std::max(1, std::min(num_workers, max_workers));
+    for (int i = 0; i < num; i++) {
+        workers_.emplace_back(Globals::config.num_scenarios, search_depth_ + max_root_depth_);
+        /* the bounds keep rollout buffers, every worker gets its own instance */
+        workers_[i].lower_bound = (i == 0) ? lb : model->CreateScenarioLowerBound("DEFAULT", "DEFAULT");
+        workers_[i].upper_bound = (i == 0) ? ub : model->CreateScenarioUpperBound("DEFAULT", "DEFAULT");
+    }
+    std::cout << "[cp_despot::CPDESPOT] search workers: " << num << std::endl;
+}
+
+CPDESPOT::~CPDESPOT()
+{
+    ResetTree();
+    for (size_t i = 1; i < workers_.size(); i++) {
+        delete workers_[i].lower_bound;
+        delete workers_[i].upper_bound;
+    }
+}
+
+ValuedAction CPDESPOT::Search()
+{
+    double start_t = get_time_second();
+    double end_t = start_t + Globals::config.time_per_move;
+    if (deadline_ > 0.0) {
+        end_t = std::min(end_t, deadline_);
+        deadline_ = -1.0;
+    }
+    int num_workers = workers_.size();
+
+    /* scenarios of new trees are sampled on the main thread (the belief draws from the global Random),
+     * under the id of the worker whose tree owns and frees them.
+     * no new tree if not even its first trial is expected to end in time
+     */
+    bool has_time = start_t + trial_time_ < end_t;
+    vector<vector<State*>> particles(num_workers);
+    int num_built = 0;
+    for (int i = 0; i < num_workers; i++) {
+        CPSearchWorker& worker = workers_[i];
+        if (worker.root != NULL || !has_time) continue;
+
+        CPWorker::SetId(i);
+        particles[i] = belief_->Sample(Globals::config.num_scenarios);
+        worker.streams = RandomStreams(Globals::config.num_scenarios, search_depth_ + max_root_depth_);
+        worker.lower_bound->Init(worker.streams);
+        worker.upper_bound->Init(worker.streams);
+        num_built++;
+    }
+    CPWorker::SetId(0);
+
+    /* Trial and the bounds stop at the absolute depth of Globals::config, which is moved
+     * by the depth of the roots (all trees are either re-rooted at the same depth or new).
+     * despot's Trial/ConstructTree take no depth argument, so the global is shared by the
+     * workers and restored after the join; nothing else may read or write it meanwhile.
+     */
+    int root_depth = (workers_[0].root != NULL) ? workers_[0].root->depth() : 0;
+    Globals::config.search_depth = search_depth_ + root_depth;
+
+    /* worker 0 runs on the calling thread */
+    vector<std::thread> threads;
+    for (int i = 1; i < num_workers; i++) {
+        threads.emplace_back(&CPDESPOT::SearchWorker, this, i, std::ref(particles[i]), end_t);
+    }
+    SearchWorker(0, particles[0], end_t);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    Globals::config.search_depth = search_depth_;
+    double search_time = get_time_second() - start_t;
+
+    int num_trials = 0;
+    int num_expanded = 0;
+    int min_trials = INT_MAX;
+    for (const auto& worker : workers_) {
+        num_trials += worker.num_trials;
+        num_expanded += worker.statistics.num_expanded_nodes;
+        if (worker.num_trials > 0) min_trials = std::min(min_trials, worker.num_trials);
+    }
+    if (min_trials != INT_MAX) {
+        trial_time_ = search_time / min_trials;
+    }
+    std::cout << "[cp_despot::Search] workers: " << num_workers 
+              << " new trees: " << num_built
+              << " root depth: " << root_depth
+              << " trials: " << num_trials
+              << " expanded nodes: " << num_expanded 
+              << " time: " << search_time << std::endl;
+
+    return MergeRoots();
+}
+
+/* build or continue the tree of one worker until end_t */
+void CPDESPOT::SearchWorker(const int worker_id, vector<State*>& particles, const double end_t)
+{
+    CPWorker::SetId(worker_id);
+    CPSearchWorker& worker = workers_[worker_id];
+    // Trial extends the history, so each worker walks its own copy
+    History history = history_;
+    worker.statistics = SearchStatistics();
+    worker.num_trials = 0;
+
+    /* no tree and no time to build one */
+    if (worker.root == NULL && particles.empty()) {
+        CPWorker::SetId(0);
+        return;
+    }
+
+    /* no tree to continue -> build a new one from the sampled scenarios */
+    if (worker.root == NULL) {
+        double timeout = std::max(0.0, end_t - get_time_second());
+        worker.root = ConstructTree(particles, worker.streams, worker.lower_bound, worker.upper_bound, model_, history, timeout, &worker.statistics);
+        worker.num_trials = worker.statistics.num_trials;
+    }
+    /* continue trials on the re-rooted tree while the next one is expected to end by end_t,
+     * before the first trial by the trial time of the last search
+     */
+    else {
+        double trial_start_t = get_time_second();
+        double trial_time = trial_time_;
+        while (get_time_second() + trial_time < end_t
+               && (worker.root->upper_bound() - worker.root->lower_bound()) > 1e-6) {
+            VNode* cur = Trial(worker.root, worker.streams, worker.lower_bound, worker.upper_bound, model_, history, &worker.statistics);
+            Backup(cur);
+            worker.num_trials++;
+            trial_time = (get_time_second() - trial_start_t) / worker.num_trials;
+        }
+    }
+
+    CPWorker::SetId(0);
+}
+
+/* average the lower bound of each root action over the workers which expanded it.
+ * bounds of a node are discounted by its depth, they are scaled back to the root first.
+ */
+ValuedAction CPDESPOT::MergeRoots() const
+{
+    vector<double> values(model_->NumActions(), 0.0);
+    vector<int> counts(model_->NumActions(), 0);
+    for (const auto& worker : workers_) {
+        if (worker.root == NULL) continue;
+        double scale = 1.0 / Globals::Discount(worker.root->depth());
+        for (ACT_TYPE action = 0; action < static_cast<ACT_TYPE>(worker.root->children().size()); action++) {
+            values[action] += worker.root->Child(action)->lower_bound() * scale;
+            counts[action]++;
+        }
+    }
+
+    ValuedAction astar(-1, Globals::NEG_INFTY);
+    for (ACT_TYPE action = 0; action < static_cast<ACT_TYPE>(values.size()); action++) {
+        if (counts[action] == 0) continue;
+        double value = values[action] / counts[action];
+        if (value > astar.value) {
+            astar = ValuedAction(action, value);
+        }
+    }
+
+    /* no root was expanded in time: action -1, the caller falls back */
+    return astar;
+}
+
+/* the trees are re-rooted all together or not at all, so that the roots of the next
+ * Search have the same depth and their bounds are merged on the same scale
+ */
+void CPDESPOT::BeliefUpdate(ACT_TYPE action, OBS_TYPE obs)
+{
+    DESPOT::BeliefUpdate(action, obs);
+    is_reused_ = false;
+
+    /* child reached by (action, obs) in every tree */
+    int num_workers = workers_.size();
+    vector<VNode*> next_roots(num_workers, NULL);
+    bool is_reusable = true;
+    for (int i = 0; i < num_workers && is_reusable; i++) {
+        VNode* root = workers_[i].root;
+        is_reusable = false;
+        if (root == NULL || action < 0 || action >= static_cast<ACT_TYPE>(root->children().size())) continue;
+
+        map<OBS_TYPE, VNode*>& children = root->Child(action)->children();
+        auto itr = children.find(obs);
+        if (itr != children.end()
+            && itr->second->depth() < max_root_depth_
+            && itr->second->particles().size() >= min_reuse_ratio_ * Globals::config.num_scenarios) {
+            next_roots[i] = itr->second;
+            is_reusable = true;
+        }
+    }
+
+    /* detach the children before the rest of the trees is freed */
+    for (int i = 0; i < num_workers; i++) {
+        if (is_reusable) {
+            workers_[i].root->Child(action)->children().erase(obs);
+        }
+        FreeTree(i);
+        if (is_reusable) {
+            next_roots[i]->parent(NULL);
+            workers_[i].root = next_roots[i];
+        }
+    }
+    is_reused_ = is_reusable;
+}
+
+void CPDESPOT::belief(Belief* b)
+{
+    ResetTree();
+    DESPOT::belief(b);
+}
+
+Belief* CPDESPOT::belief()
+{
+    return belief_;
+}
+
+bool CPDESPOT::HasTree() const
+{
+    return is_reused_;
+}
+
+void CPDESPOT::ResetTree()
+{
+    for (int i = 0; i < NumWorkers(); i++) {
+        FreeTree(i);
+    }
+    is_reused_ = false;
+}
+
+int CPDESPOT::NumWorkers() const
+{
+    return workers_.size();
+}
+
+/* applies to the next Search only */
+void CPDESPOT::SetDeadline(const double deadline_t)
+{
+    deadline_ = deadline_t;
+}
+
+/* particles go back to the pool of the worker which allocated them */
+void CPDESPOT::FreeTree(const int worker_id)
+{
+    VNode*& root = workers_[worker_id].root;
+    if (root == NULL) return;
+
+    CPWorker::SetId(worker_id);
+    root->Free(*model_);
+    delete root;
+    root = NULL;
+    CPWorker::SetId(0);
+}
+
+} // namespace despot
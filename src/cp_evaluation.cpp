@@ -0,0 +1,324 @@
+#include "cooperative_perception/cooperative_perception.hpp"
+#include "cooperative_perception/cp_json.hpp"
+#include <despot/util/seeds.h>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+/* offline policy evaluation on CPSimWorld
+ *   cp_evaluation [options] config.json ...
+ *     --policy DESPOT,MYOPIC,NOREQUEST : policies to evaluate (default: all)
+ *     --episodes N                     : episodes per config and policy (default: 100)
+ *     --jobs N                         : episodes running at the same time (default: cores / search workers)
+ *     --seed N                         : base seed (default: 0)
+ *     --time-per-move T                : search time of a step [s] (default: time_per_move of the config)
+ *     --search-workers N               : DESPOT search threads of one episode (default: 1)
+ *     --persistent                     : keep the DESPOT tree across steps (default: rebuild every step)
+ *     --output FILE                    : (default: stdout)
+ *     --verbose                        : planner output to stderr (default: discarded)
+ *
+ * one json line per episode is written as soon as it finishes, with the fields of the
+ * "log" entries in config/param_*.json plus config, policy, seed and steps. the reward stderr
+ * fields are left out (one episode has none), the summary per config and policy on stderr
+ * at the end reports them. the exit status is 1 if an episode failed.
+ *
+ * every episode runs in its own process: despot keeps its random generator, seeds and
+ * config in globals, so episodes on threads of one process would not be independent.
+ * an episode gets the same seed under every policy (same hidden risk and operator draws).
+ */
+
+namespace {
+
+struct EvalOptions {
+    std::vector<std::string> policies = {"DESPOT", "MYOPIC", "NOREQUEST"};
+    int episodes = 100;
+    int jobs = 0;
+    uint64_t seed = 0;
+    double time_per_move = -1.0;
+    int search_workers = 1;
+    bool persistent = false;
+    std::string output;
+    bool verbose = false;
+    std::vector<std::string> configs;
+};
+
+struct EvalJob {
+    int config;
+    int policy;
+    int episode;
+    uint64_t seed;
+};
+
+/* sent from the episode process through a pipe */
+struct EvalResult {
+    int steps;
+    double discounted_reward;
+    double undiscounted_reward;
+};
+
+struct EvalSummary {
+    int num = 0;
+    int num_failed = 0;
+    double sum = 0.0, sum_sq = 0.0;
+    double sum_undiscounted = 0.0, sum_sq_undiscounted = 0.0;
+};
+
+
+/* splitmix64, seeds of neighbouring episodes are unrelated */
+uint64_t MixSeed(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+std::vector<std::string> Split(const std::string &text, const char delimiter)
+{
+    std::vector<std::string> out;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, delimiter)) {
+        if (!item.empty()) out.emplace_back(item);
+    }
+    return out;
+}
+
+
+bool ParseOptions(int argc, char* argv[], EvalOptions &options)
+{
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = (i + 1 < argc);
+        if (arg == "--policy" && has_value) options.policies = Split(argv[++i], ',');
+        else if (arg == "--episodes" && has_value) options.episodes = std::atoi(argv[++i]);
+        else if (arg == "--jobs" && has_value) options.jobs = std::atoi(argv[++i]);
+        else if (arg == "--seed" && has_value) options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--time-per-move" && has_value) options.time_per_move = std::atof(argv[++i]);
+        else if (arg == "--search-workers" && has_value) options.search_workers = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--persistent") options.persistent = true;
+        else if (arg == "--output" && has_value) options.output = argv[++i];
+        else if (arg == "--verbose") options.verbose = true;
+        else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "[cp_evaluation] unknown option " << arg << std::endl;
+            return false;
+        }
+        else options.configs.emplace_back(arg);
+    }
+
+    for (const auto &policy : options.policies) {
+        if (policy != "DESPOT" && policy != "MYOPIC" && policy != "NOREQUEST") {
+            std::cerr << "[cp_evaluation] unknown policy " << policy << std::endl;
+            return false;
+        }
+    }
+    if (options.configs.empty() || options.policies.empty() || options.episodes <= 0) {
+        std::cerr << "usage: cp_evaluation [--policy DESPOT,MYOPIC,NOREQUEST] [--episodes N] [--jobs N] [--seed N] "
+                  << "[--time-per-move T] [--search-workers N] [--persistent] [--output FILE] [--verbose] config.json ..." << std::endl;
+        return false;
+    }
+    if (options.jobs <= 0) {
+        int cores = std::max(1u, std::thread::hardware_concurrency());
+        options.jobs = std::max(1, cores / options.search_workers);
+    }
+    return true;
+}
+
+
+/* runs in the episode process */
+EvalResult RunJob(const CPSimConfig &config, const std::string &policy, const EvalJob &job, const EvalOptions &options)
+{
+    Globals::config.time_per_move = (options.time_per_move > 0.0) ? options.time_per_move : config.time_per_move;
+    Seeds::root_seed(static_cast<unsigned>(job.seed >> 32));
+    Random::RANDOM = Random(Seeds::Next());
+
+    CPSimWorld world(config, static_cast<unsigned>(job.seed));
+    CooperativePerception planner;
+    EvalResult result;
+    result.steps = planner.RunEpisode(&world, policy, options.persistent, options.search_workers, result.discounted_reward, result.undiscounted_reward);
+    return result;
+}
+
+
+void WriteResult(std::ostream &out, const std::string &path, const CPSimConfig &config, const std::string &policy,
+                 const EvalJob &job, const EvalResult &result, const double time_per_move)
+{
+    /* keys in the order of the existing logs (sorted) */
+    out << "{\"config\": " << CPJson::Quote(path)
+        << ", \"delta_t\": " << config.delta_t
+        << ", \"policy\": " << CPJson::Quote(policy)
+        << ", \"risk_likelihood\": [";
+    for (size_t i = 0; i < config.risk_likelihood.size(); i++) {
+        out << ((i == 0) ? "" : ", ") << config.risk_likelihood[i];
+    }
+    out << "], \"risk_pose\": [";
+    for (size_t i = 0; i < config.risk_pose.size(); i++) {
+        out << ((i == 0) ? "" : ", ") << config.risk_pose[i];
+    }
+    out << "], \"seed\": " << job.seed
+        << ", \"steps\": " << result.steps
+        << ", \"time_per_move\": " << time_per_move
+        << ", \"total discounted reward\": " << result.discounted_reward
+        << ", \"total undiscounted reward\": " << result.undiscounted_reward << "}\n";
+    out.flush();
+}
+
+
+double StdErr(const int num, const double sum, const double sum_sq)
+{
+    if (num < 2) return 0.0;
+    double mean = sum / num;
+    double var = std::max(0.0, (sum_sq - num * mean * mean) / (num - 1));
+    return std::sqrt(var / num);
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[])
+{
+    EvalOptions options;
+    if (!ParseOptions(argc, argv, options)) return 1;
+
+    std::vector<CPSimConfig> configs(options.configs.size());
+    for (size_t i = 0; i < options.configs.size(); i++) {
+        if (!CPSimConfig::Load(options.configs[i], configs[i])) return 1;
+        for (const auto &type : configs[i].risk_type) {
+            CPTypeTable::GetId(type);
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            std::cerr << "[cp_evaluation] cannot open " << options.output << std::endl;
+            return 1;
+        }
+    }
+    std::ostream &out = options.output.empty() ? std::cout : file;
+    out << std::setprecision(15);
+
+    /* same defaults as CooperativePerception::InitializeDefaultParameters */
+    Globals::config.num_scenarios = 100;
+    Globals::config.sim_len = 90;
+
+    std::vector<EvalJob> jobs;
+    for (int c = 0; c < int(configs.size()); c++) {
+        for (int e = 0; e < options.episodes; e++) {
+            uint64_t seed = MixSeed(options.seed ^ MixSeed((uint64_t(c) << 32) | uint64_t(e)));
+            for (int p = 0; p < int(options.policies.size()); p++) {
+                jobs.push_back({c, p, e, seed});
+            }
+        }
+    }
+    std::cerr << "[cp_evaluation] " << jobs.size() << " episodes on " << options.jobs << " processes" << std::endl;
+
+    std::vector<EvalSummary> summaries(configs.size() * options.policies.size());
+    std::map<pid_t, std::pair<size_t, int>> running; // pid -> job, read end of the pipe
+    size_t next = 0;
+    while (next < jobs.size() || !running.empty()) {
+
+        /* start episodes up to the number of jobs */
+        while (next < jobs.size() && int(running.size()) < options.jobs) {
+            const EvalJob &job = jobs[next];
+            int fds[2];
+            if (pipe(fds) != 0) {
+                std::cerr << "[cp_evaluation] pipe: " << std::strerror(errno) << std::endl;
+                return 1;
+            }
+            out.flush();
+            std::cout.flush();
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                /* the planner writes to stdout, which carries the json lines of the parent */
+                if (options.verbose) {
+                    dup2(STDERR_FILENO, STDOUT_FILENO);
+                }
+                else {
+                    int null_fd = open("/dev/null", O_WRONLY);
+                    if (null_fd >= 0) {
+                        dup2(null_fd, STDOUT_FILENO);
+                        close(null_fd);
+                    }
+                }
+                EvalResult result = RunJob(configs[job.config], options.policies[job.policy], job, options);
+                ssize_t written = write(fds[1], &result, sizeof(result));
+                /* _exit skips the stdio flush at exit */
+                std::cout.flush();
+                std::fflush(stdout);
+                _exit(written == static_cast<ssize_t>(sizeof(result)) ? 0 : 1);
+            }
+            close(fds[1]);
+            if (pid < 0) {
+                std::cerr << "[cp_evaluation] fork: " << std::strerror(errno) << std::endl;
+                close(fds[0]);
+                if (running.empty()) return 1;
+                break;
+            }
+            running[pid] = {next, fds[0]};
+            next++;
+        }
+
+        /* collect the next finished episode */
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "[cp_evaluation] waitpid: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+        auto itr = running.find(pid);
+        if (itr == running.end()) continue;
+        const EvalJob &job = jobs[itr->second.first];
+        int fd = itr->second.second;
+        running.erase(itr);
+
+        EvalResult result;
+        ssize_t num_read = read(fd, &result, sizeof(result));
+        close(fd);
+
+        EvalSummary &summary = summaries[job.config * options.policies.size() + job.policy];
+        if (num_read != static_cast<ssize_t>(sizeof(result)) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            summary.num_failed++;
+            std::cerr << "[cp_evaluation] episode failed: " << options.configs[job.config] << " " << options.policies[job.policy]
+                      << " seed " << job.seed << std::endl;
+            continue;
+        }
+
+        double time_per_move = (options.time_per_move > 0.0) ? options.time_per_move : configs[job.config].time_per_move;
+        WriteResult(out, options.configs[job.config], configs[job.config], options.policies[job.policy], job, result, time_per_move);
+
+        summary.num++;
+        summary.sum += result.discounted_reward;
+        summary.sum_sq += result.discounted_reward * result.discounted_reward;
+        summary.sum_undiscounted += result.undiscounted_reward;
+        summary.sum_sq_undiscounted += result.undiscounted_reward * result.undiscounted_reward;
+    }
+
+    int num_failed = 0;
+    for (size_t c = 0; c < configs.size(); c++) {
+        for (size_t p = 0; p < options.policies.size(); p++) {
+            const EvalSummary &summary = summaries[c * options.policies.size() + p];
+            num_failed += summary.num_failed;
+            int num = std::max(1, summary.num);
+            std::cerr << "[cp_evaluation] " << options.configs[c] << " " << options.policies[p]
+                      << " episodes: " << summary.num << " failed: " << summary.num_failed
+                      << " discounted: " << summary.sum / num << " +- " << StdErr(summary.num, summary.sum, summary.sum_sq)
+                      << " undiscounted: " << summary.sum_undiscounted / num << " +- " << StdErr(summary.num, summary.sum_undiscounted, summary.sum_sq_undiscounted)
+                      << std::endl;
+        }
+    }
+    return (num_failed > 0) ? 1 : 0;
+}
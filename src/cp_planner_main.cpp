@@ -0,0 +1,17 @@
+#include "cooperative_perception/cp_planner_node.hpp"
+
+/* standalone planner: the command line goes to the node options,
+ * so that despot options reach CPPlannerNode next to the ros arguments
+ */
+int main(int argc, char* argv[])
+{
+    rclcpp::init(argc, argv);
+    rclcpp::NodeOptions options;
+    options.arguments(std::vector<std::string>(argv, argv + argc));
+
+    auto node = std::make_shared<CPPlannerNode>(options);
+    rclcpp::spin(node);
+    node.reset();
+    rclcpp::shutdown();
+    return 0;
+}
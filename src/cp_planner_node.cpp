@@ -0,0 +1,73 @@
+#include "cooperative_perception/cp_planner_node.hpp"
+
+CPPlannerNode::CPPlannerNode(const rclcpp::NodeOptions &options)
+    : Node("CPWorldNode", options),
+      stop_requested_(std::make_shared<std::atomic<bool>>(false))
+{
+    planner_config_ = CPThreadConfig::Declare(this, "planner");
+    io_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    io_thread_.Start(io_group_, this->get_node_base_interface(), CPThreadConfig::Declare(this, "planner_io"));
+
+    /* ros arguments are applied by the node, the rest goes to despot */
+    std::vector<const char*> argv;
+    for (const auto &arg : options.arguments()) {
+        argv.emplace_back(arg.c_str());
+    }
+    if (!argv.empty()) {
+        planner_args_ = rclcpp::remove_ros_arguments(argv.size(), argv.data());
+    }
+    if (planner_args_.empty()) {
+        planner_args_.emplace_back("cooperative_perception");
+    }
+
+    /* weak_from_this is not available in the constructor, start from the executor */
+    start_timer_ = this->create_wall_timer(std::chrono::milliseconds(0), std::bind(&CPPlannerNode::Start, this));
+}
+
+CPPlannerNode::~CPPlannerNode()
+{
+    stop_requested_->store(true);
+    if (!planner_thread_.joinable()) return;
+
+    /* the planner thread can drop the last reference to this node before it starts planning */
+    if (planner_thread_.get_id() == std::this_thread::get_id()) {
+        planner_thread_.detach();
+    }
+    else {
+        planner_thread_.join();
+    }
+}
+
+void CPPlannerNode::Start()
+{
+    start_timer_->cancel();
+
+    std::weak_ptr<rclcpp::Node> weak_node = weak_from_this();
+    rclcpp::CallbackGroup::SharedPtr io_group = io_group_;
+    CPThreadConfig config = planner_config_;
+    std::vector<std::string> args = planner_args_;
+    std::shared_ptr<std::atomic<bool>> stop_requested = stop_requested_;
+    planner_thread_ = std::thread([weak_node, io_group, config, args, stop_requested]() {
+        /* the planner gets a handle which does not own the node, the destructor joins
+         * this thread before the node goes away
+         */
+        rclcpp::Node::SharedPtr owner = weak_node.lock();
+        if (owner == nullptr) return;
+        rclcpp::Node::SharedPtr node(rclcpp::Node::SharedPtr(), owner.get());
+        owner.reset();
+        if (stop_requested->load()) return;
+
+        config.Apply();
+        std::vector<std::string> arg_buffers = args;
+        std::vector<char*> argv;
+        for (auto &arg : arg_buffers) {
+            argv.emplace_back(&arg[0]);
+        }
+        argv.emplace_back(nullptr);
+        CooperativePerception(node, io_group, stop_requested.get()).RunPlanning(arg_buffers.size(), argv.data());
+        RCLCPP_INFO(node->get_logger(), "[cp_planner_node::Start] planning finished");
+    });
+}
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(CPPlannerNode)
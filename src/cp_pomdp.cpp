@@ -5,6 +5,9 @@
 #include "despot/core/builtin_upper_bounds.h"
 #include "despot/core/particle_belief.h"
 
+#include <set>
+#include <thread>
+
 using namespace std;
 
 namespace despot {
@@ -34,13 +37,85 @@ public:
 
             if (cp_state.req_time > 0) { 
 
-                if (cp_model->operator_model_->InterventionAccuracy(cp_state.req_time, cp_state.risk_type[cp_state.req_target]) <= 0.5) {
+                if (cp_model->scenario_.Accuracy(cp_state.req_target, cp_state.req_time) <= 0.5) {
                     return cp_values->getAction(CPValues::REQUEST, cp_state.req_target);
                 }
             }
         }
         return cp_model->cp_values_->getAction(CPValues::NO_ACTION, 0);
     }
+
+    /* rollout of the whole particle set with CPPOMDP::StepBatch.
+     * Action only depends on the request state, which is common to the particles of a node,
+     * so the per observation branches of DefaultPolicy::Value follow the same actions and are merged here.
+     */
+    ValuedAction Value(const vector<State*>& particles, RandomStreams& streams, History& history) const {
+        int initial_depth = history.Size();
+        if (particles.empty() || streams.Exhausted() || Globals::config.max_policy_sim_len <= 0) {
+            return particle_lower_bound_->Value(particles);
+        }
+
+        batch_.Load(particles);
+        CPState* head = static_cast<CPState*>(cp_model->Copy(particles[0]));
+        vector<State*> head_list(1, head);
+
+        ACT_TYPE first_action = -1;
+        double value = 0.0;
+        double discount = 1.0;
+        int depth = 0;
+        while (true) {
+            batch_.Store(0, head);
+            ACT_TYPE action = Action(head_list, streams, history);
+            if (first_action < 0) first_action = action;
+
+            rand_nums_.resize(batch_.Size());
+            for (int i = 0; i < batch_.Size(); i++) {
+                rand_nums_[i] = streams.Entry(batch_.scenario_id[i]);
+            }
+            cp_model->StepBatch(batch_, rand_nums_.data(), action);
+
+            double step_value = 0.0;
+            for (int i = 0; i < batch_.Size(); i++) {
+                step_value += batch_.reward[i] * batch_.weight[i];
+            }
+            value += discount * step_value;
+
+            batch_.RemoveTerminal();
+            if (batch_.Size() == 0) break;
+
+            history.Add(action, batch_.obs[0]);
+            streams.Advance();
+            depth++;
+            discount *= Globals::config.discount;
+
+            /* leaf : value of the remaining particles */
+            if (streams.Exhausted() || int(history.Size()) - initial_depth >= Globals::config.max_policy_sim_len) {
+                vector<State*> leaf_particles;
+                for (int i = 0; i < batch_.Size(); i++) {
+                    CPState* leaf = static_cast<CPState*>(cp_model->Copy(particles[batch_.index[i]]));
+                    batch_.Store(i, leaf);
+                    leaf_particles.push_back(leaf);
+                }
+                value += discount * particle_lower_bound_->Value(leaf_particles).value;
+                for (auto leaf : leaf_particles) {
+                    cp_model->Free(leaf);
+                }
+                break;
+            }
+        }
+
+        for (int i = 0; i < depth; i++) {
+            streams.Back();
+        }
+        history.Truncate(initial_depth);
+        cp_model->Free(head);
+
+        return ValuedAction(first_action, value);
+    }
+
+private:
+    mutable CPParticleBatch batch_;
+    mutable vector<double> rand_nums_;
 };
 
 
@@ -70,10 +145,11 @@ CPPOMDP::CPPOMDP() {
     max_speed_ = vehicle_model_->max_speed_;
     yield_speed_ = vehicle_model_->yield_speed_;
 
+    memory_pools_.emplace_back(new MemoryPool<CPState>());
 }
 
 
-CPPOMDP::CPPOMDP (const int planning_horizon, const double risk_thresh, const double delta_t, VehicleModel* vehicle_model, OperatorModel* operator_model, State* state) 
+CPPOMDP::CPPOMDP (const int planning_horizon, const double risk_thresh, const double delta_t, VehicleModel* vehicle_model, OperatorModel* operator_model, const CPScenario* scenario) 
     : planning_horizon_(planning_horizon),
       risk_thresh_(risk_thresh),
       delta_t_(delta_t),
@@ -83,7 +159,28 @@ CPPOMDP::CPPOMDP (const int planning_horizon, const double risk_thresh, const do
       max_speed_(vehicle_model->max_speed_)
 
 { 
-    cp_values_ = new CPValues(static_cast<CPState*>(state)->risk_pose.size());
+    memory_pools_.emplace_back(new MemoryPool<CPState>());
+    cp_values_ = new CPValues(scenario->num_targets);
+    SyncTargets(scenario);
+}
+
+CPPOMDP::~CPPOMDP ()
+{
+    for (auto pool : memory_pools_) {
+        delete pool;
+    }
+}
+
+
+/* prepare per-worker particle pools and transition caches for a parallel search.
+ * must be called from the main thread while no search is running.
+ */
+void CPPOMDP::SetNumWorkers (const int num_workers)
+{
+    while (static_cast<int>(memory_pools_.size()) < num_workers) {
+        memory_pools_.emplace_back(new MemoryPool<CPState>());
+    }
+    vehicle_model_->SetNumWorkers(num_workers);
 }
 
 
@@ -130,7 +227,7 @@ bool CPPOMDP::Step(State& state, double rand_num, ACT_TYPE action, double& rewar
 	/* ego state trantion
 	* EgoVehicleTransition(state_curr.ego_pose, state_curr.ego_speed, state_prev.ego_recog, risk_pose, action);
     */
-    vehicle_model_->GetTransition(state_curr.ego_speed, state_curr.ego_pose, state_prev.ego_recog, state_prev.risk_pose);
+    vehicle_model_->GetTransition(state_curr.ego_speed, state_curr.ego_pose, state_prev.ego_recog, scenario_.risk_pose.data(), scenario_.sorted_idx.data(), scenario_.num_targets, scenario_.layout_id);
     
     int target_idx = cp_values_->getActionTarget(action);
     CPValues::ACT cp_action = cp_values_->getActionAttrib(action);
@@ -138,7 +235,7 @@ bool CPPOMDP::Step(State& state, double rand_num, ACT_TYPE action, double& rewar
     // when action == no_action
     if (cp_action == CPValues::NO_ACTION) {
         state_curr.req_time = 0;
-        obs = operator_model_->ExecIntervention(0, false, rand_num, "");
+        obs = operator_model_->ExecIntervention(0, false, rand_num, 0.5);
     }
     
 	// when action = request intervention
@@ -155,8 +252,8 @@ bool CPPOMDP::Step(State& state, double rand_num, ACT_TYPE action, double& rewar
 			state_curr.req_time = delta_t_;
 		}
 
-        obs = operator_model_->ExecIntervention(state_curr.req_time, state_curr.risk_bin[state_curr.req_target], rand_num, state_curr.risk_type[state_curr.req_target]);
-        state_curr.ego_recog[state_curr.req_target] = obs;
+        obs = operator_model_->ExecIntervention(state_curr.req_time, state_curr.GetRisk(state_curr.req_target), rand_num, scenario_.Accuracy(state_curr.req_target, state_curr.req_time));
+        state_curr.SetRecog(state_curr.req_target, obs);
 
 	}
 	reward = CalcReward(state_prev, state_curr, action);
@@ -168,6 +265,93 @@ bool CPPOMDP::Step(State& state, double rand_num, ACT_TYPE action, double& rewar
 }
 
 
+/* Step for a whole particle set in structure-of-arrays layout, same results as Step on every particle.
+ * apart from the (memoized) vehicle transition every pass is a branch free loop over the arrays
+ * so that the compiler can vectorize it.
+ */
+void CPPOMDP::StepBatch(CPParticleBatch& batch, const double* rand_nums, ACT_TYPE action) const {
+    const int num = batch.Size();
+
+    double* speed = batch.ego_speed.data();
+    int* pose = batch.ego_pose.data();
+    int* req_time = batch.req_time.data();
+    int* req_target = batch.req_target.data();
+    uint64_t* recog = batch.ego_recog.data();
+    const uint64_t* risk_bin = batch.risk_bin.data();
+    double* prev_speed = batch.prev_speed.data();
+    int* prev_pose = batch.prev_pose.data();
+    int* prev_req_time = batch.prev_req_time.data();
+    int* prev_req_target = batch.prev_req_target.data();
+    int* buf_reward = batch.buf_reward.data();
+
+    for (int i = 0; i < num; i++) {
+        prev_speed[i] = speed[i];
+        prev_pose[i] = pose[i];
+        prev_req_time[i] = req_time[i];
+        prev_req_target[i] = req_target[i];
+        buf_reward[i] = 0;
+    }
+
+    /* ego state transition with the recognition before the action */
+    for (int i = 0; i < num; i++) {
+        vehicle_model_->GetTransition(speed[i], pose[i], recog[i], scenario_.risk_pose.data(), scenario_.sorted_idx.data(), scenario_.num_targets, scenario_.layout_id);
+    }
+
+    int target_idx = cp_values_->getActionTarget(action);
+    CPValues::ACT cp_action = cp_values_->getActionAttrib(action);
+    const bool is_request = (cp_action == CPValues::REQUEST);
+
+    /* intervention */
+    if (!is_request) {
+        for (int i = 0; i < num; i++) {
+            req_time[i] = 0;
+            batch.obs[i] = CPValues::RISK;
+        }
+    }
+    else {
+        const int continued_time = delta_t_;
+        for (int i = 0; i < num; i++) {
+            bool is_continued = (prev_req_target[i] == target_idx || prev_req_time[i] == 0);
+            req_time[i] = (is_continued) ? static_cast<int>(req_time[i] + delta_t_) : continued_time;
+            req_target[i] = target_idx;
+        }
+        for (int i = 0; i < num; i++) {
+            bool risk = (risk_bin[i] >> target_idx) & 1ULL;
+            bool correct = rand_nums[i] <= scenario_.Accuracy(target_idx, req_time[i]);
+            OBS_TYPE obs = (req_time[i] == 0 || correct == risk) ? CPValues::RISK : CPValues::NO_RISK;
+            batch.obs[i] = obs;
+            recog[i] = (recog[i] & ~(1ULL << target_idx)) | (static_cast<uint64_t>(obs) << target_idx);
+        }
+    }
+
+    /* reward (see CalcReward), accumulated as int like CalcReward */
+    const double speed_range = vehicle_model_->max_speed_ - vehicle_model_->yield_speed_;
+    for (int t = 0; t < scenario_.num_targets; t++) {
+        const int target_pose = scenario_.risk_pose[t];
+        for (int i = 0; i < num; i++) {
+            bool is_passed = (prev_pose[i] <= target_pose && target_pose < pose[i]);
+            bool risk = (risk_bin[i] >> t) & 1ULL;
+            double safety = (speed[i] - vehicle_model_->yield_speed_)/speed_range * -100.0;
+            double efficiency = (vehicle_model_->max_speed_ - prev_speed[i])/speed_range * -100.0;
+            buf_reward[i] = (is_passed) ? static_cast<int>(buf_reward[i] + ((risk) ? safety : efficiency)) : buf_reward[i];
+        }
+    }
+
+    for (int i = 0; i < num; i++) {
+        double deceleration = (speed[i] < prev_speed[i]) ? (speed[i] - prev_speed[i])/delta_t_ : 0.0;
+        buf_reward[i] = static_cast<int>(buf_reward[i] + ((deceleration < -vehicle_model_->max_decel_) ? -100.0 : 0.0));
+    }
+
+    for (int i = 0; i < num; i++) {
+        bool is_request_end = prev_req_time[i] > 0 && (!is_request || req_target[i] != prev_req_target[i]);
+        bool is_mistake = ((risk_bin[i] >> prev_req_target[i]) & 1ULL) != ((recog[i] >> prev_req_target[i]) & 1ULL);
+        buf_reward[i] += (is_request_end && is_mistake) ? -100 : 0;
+        batch.reward[i] = buf_reward[i];
+        batch.terminal[i] = pose[i] >= planning_horizon_;
+    }
+}
+
+
 double CPPOMDP::ObsProb(OBS_TYPE obs, const State& state, ACT_TYPE action) const 
 {
     int target_idx = cp_values_->getActionTarget(action);
@@ -178,8 +362,8 @@ double CPPOMDP::ObsProb(OBS_TYPE obs, const State& state, ACT_TYPE action) const
         return obs == CPValues::RISK;
     }
     else {
-        double acc = operator_model_->InterventionAccuracy(cp_state.req_time, cp_state.risk_type[cp_state.req_target]);
-        return (cp_state.risk_bin[cp_state.req_target] == obs) ? acc : 1.0 - acc;
+        double acc = scenario_.Accuracy(cp_state.req_target, cp_state.req_time);
+        return (cp_state.GetRisk(cp_state.req_target) == obs) ? acc : 1.0 - acc;
     }
 }
 
@@ -192,12 +376,12 @@ int CPPOMDP::CalcReward(const State& _state_prev, const State& _state_curr, cons
     int action_target_idx = cp_values_->getActionTarget(action);
     CPValues::ACT cp_action = cp_values_->getActionAttrib(action);
 
-	for (auto it=state_curr.risk_pose.begin(), end=state_curr.risk_pose.end(); it != end; ++it) {
-		if (state_prev.ego_pose <= *it && *it < state_curr.ego_pose) {
-            int passed_index = distance(state_curr.risk_pose.begin(), it);
+	for (int passed_index = 0; passed_index < scenario_.num_targets; passed_index++) {
+        int pose = scenario_.risk_pose[passed_index];
+		if (state_prev.ego_pose <= pose && pose < state_curr.ego_pose) {
 
             /* driving safety */
-            if (state_curr.risk_bin[passed_index] == CPValues::RISK) {
+            if (state_curr.GetRisk(passed_index) == CPValues::RISK) {
                 reward += (state_curr.ego_speed - vehicle_model_->yield_speed_)/(vehicle_model_->max_speed_ - vehicle_model_->yield_speed_) * -100.0;
             }
             /* driving efficiency */
@@ -219,7 +403,7 @@ int CPPOMDP::CalcReward(const State& _state_prev, const State& _state_curr, cons
     /* end of the request */
     if (state_prev.req_time > 0 && (cp_action != CPValues::REQUEST || state_curr.req_target != state_prev.req_target)) {
         /* when operator took mistake <- if no penalty, bet 0.5 of obs = no-risk if it want to keep speed*/
-        if (state_curr.risk_bin[state_prev.req_target] != state_curr.ego_recog[state_prev.req_target]) {
+        if (state_curr.GetRisk(state_prev.req_target) != state_curr.GetRecog(state_prev.req_target)) {
             reward += -100.0;
         }
     }
@@ -246,53 +430,118 @@ Belief* CPPOMDP::InitialBelief (const State* start, const std::vector<double>& l
    
     const CPState *cp_start_state = static_cast<const CPState*>(start);
 
-    if (likelihood.size() != cp_start_state->risk_pose.size()) {
+    if (int(likelihood.size()) != scenario_.num_targets) {
         std::cout << "likelihood and risk have different list size!" << "\n"
             << "likelihood: " << likelihood[0]
-            << "risk: " << cp_start_state->risk_pose.size() 
+            << "risk: " << scenario_.num_targets 
             << std::endl;
         exit(0);
     }
 
 	// recognition likelihood of the automated system
-    vector<bool> buf(cp_start_state->risk_pose.size(), false);
 	vector<vector<bool>> risk_bin_list;
-	GetBinProduct(risk_bin_list, buf, 0); 
+    bool is_sampled = (type == "SAMPLE" || scenario_.num_targets > max_enum_targets_);
+    if (is_sampled) {
+        SampleBinProduct(risk_bin_list, likelihood, Globals::config.num_scenarios);
+    }
+    else {
+        vector<bool> buf(scenario_.num_targets, false);
+        GetBinProduct(risk_bin_list, buf, 0); 
+    }
 	vector<State*> particles;
+    double total_prob = 0.0;
 
 	for (auto row : risk_bin_list) {
 		double prob = 1.0;
-		vector<bool> _risk_bin;
+		uint64_t _risk_bin = 0;
 		// set ego_recog and risk_bin based on threshold
 		for (auto col=row.begin(), end=row.end(); col!=end; col++) {
 			int idx = distance(row.begin(), col);
 			if (*col) {
 				prob *= likelihood[idx]; 
-				_risk_bin.emplace_back(true);
+				_risk_bin |= (1ULL << idx);
 			}
 			else {
 				prob *= 1.0 - likelihood[idx]; 
-				_risk_bin.emplace_back(false);
 			}
 		}
 
         // TODO define based on the given sitiation
-		CPState* p = static_cast<CPState*>(Allocate(-1, prob));  
-		p->ego_pose = cp_start_state->ego_pose;
-		p->ego_speed = cp_start_state->ego_speed;
-		p->ego_recog = cp_start_state->ego_recog;
-		p->req_time = cp_start_state->req_time;
-	  	p->req_target = cp_start_state->req_target;
-	  	p->risk_pose = cp_start_state->risk_pose;
-        p->risk_type = cp_start_state->risk_type;
+		CPState* p = static_cast<CPState*>(Copy(cp_start_state));  
+		p->state_id = -1;
+		p->weight = prob;
 		p->risk_bin = _risk_bin;
         cout << *p << endl;
 		particles.push_back(p);
+        total_prob += prob;
 	}
+
+    /* sampled support does not cover every combination -> normalize the exact probabilities */
+    if (is_sampled) {
+        for (auto p : particles) {
+            p->weight /= total_prob;
+        }
+    }
     std::cout << "[cp_pomdp.cpp] initial belief created" << std::endl;
 	return new ParticleBelief(particles, this);
 }
 
+/* carry the hidden risk of the previous belief over to the current targets.
+ * observable values are taken from the start state, targets which newly appeared are sampled from the likelihood.
+ * prev_idx_list[i] is the index of the target i in the previous belief, or -1 if it is new.
+ */
+Belief* CPPOMDP::PatchBelief (const Belief* prev_belief, const State* start, const std::vector<double>& likelihood, const std::vector<int>& prev_idx_list) const {
+
+    const CPState *cp_start_state = static_cast<const CPState*>(start);
+	const vector<State*>& prev_particles = static_cast<const ParticleBelief*>(prev_belief)->particles();
+
+    if (prev_particles.empty() || prev_idx_list.size() != likelihood.size()) {
+        return InitialBelief(start, likelihood);
+    }
+
+	vector<State*> particles;
+	for (const auto prev_particle : prev_particles) {
+		const CPState* prev_state = static_cast<const CPState*>(prev_particle);
+
+		CPState* p = static_cast<CPState*>(Copy(cp_start_state));
+		p->state_id = -1;
+		p->weight = prev_particle->weight;
+
+		for (int i = 0; i < scenario_.num_targets; i++) {
+			int prev_idx = prev_idx_list[i];
+			if (0 <= prev_idx && prev_idx < CP_MAX_TARGETS) {
+				p->SetRisk(i, prev_state->GetRisk(prev_idx));
+			}
+			else {
+				p->SetRisk(i, Random::RANDOM.NextDouble() < likelihood[i]);
+			}
+		}
+		particles.push_back(p);
+	}
+    std::cout << "[cp_pomdp.cpp] belief patched" << std::endl;
+	return new ParticleBelief(particles, this);
+}
+
+/* take over the target layout of the step and precompute what every particle shares:
+ * sorted target order and operator accuracy curve of each target.
+ * action space is resized to the targets.
+ */
+void CPPOMDP::SyncTargets (const CPScenario* scenario) {
+    scenario_ = *scenario;
+    scenario_.SortTargets();
+
+    scenario_.max_req_time = planning_horizon_;
+    scenario_.acc_curve.resize(scenario_.num_targets * (scenario_.max_req_time + 1));
+    for (int i = 0; i < scenario_.num_targets; i++) {
+        for (int t = 0; t <= scenario_.max_req_time; t++) {
+            scenario_.acc_curve[i * (scenario_.max_req_time + 1) + t] = operator_model_->InterventionAccuracy(t, scenario_.risk_type[i]);
+        }
+    }
+
+    vehicle_model_->ResetTransitionCache(scenario_.layout_id);
+    *cp_values_ = CPValues(scenario_.num_targets);
+}
+
 // get every combination of the recognition state.
 // [[true, true], [true, false], [false, true], [false, false]] for 2 obstacles
 void CPPOMDP::GetBinProduct(vector<vector<bool>>& out_list, std::vector<bool> buf, int row) const {
@@ -310,6 +559,59 @@ void CPPOMDP::GetBinProduct(vector<vector<bool>>& out_list, std::vector<bool> bu
     }
 }
 
+/* sample distinct risk combinations from the independent per-target likelihood.
+ * large batches are split over the cores, each worker has its own random stream.
+ * a batch below min_samples_per_worker_ per core is drawn on the calling thread.
+ * duplicated samples are merged, the caller weights each combination by its exact probability.
+ */
+void CPPOMDP::SampleBinProduct(vector<vector<bool>>& out_list, const vector<double>& likelihood, int num) const {
+
+    int num_workers = std::max(1, std::min(num / min_samples_per_worker_, static_cast<int>(std::thread::hardware_concurrency())));
+    vector<vector<vector<bool>>> worker_list(num_workers);
+    vector<unsigned> seeds;
+    for (int i = 0; i < num_workers; i++) {
+        seeds.emplace_back(Random::RANDOM.NextUnsigned());
+    }
+
+    auto sample = [&likelihood, &worker_list, &seeds, num, num_workers](const int i) {
+        int worker_num = num / num_workers + ((i < num % num_workers) ? 1 : 0);
+        Random random(seeds[i]);
+        vector<vector<bool>>& samples = worker_list[i];
+        samples.reserve(worker_num);
+        for (int j = 0; j < worker_num; j++) {
+            vector<bool> row(likelihood.size());
+            for (size_t k = 0; k < likelihood.size(); k++) {
+                row[k] = random.NextDouble() < likelihood[k];
+            }
+            samples.emplace_back(std::move(row));
+        }
+    };
+
+    if (num_workers == 1) {
+        sample(0);
+    }
+    else {
+        vector<std::thread> workers;
+        for (int i = 1; i < num_workers; i++) {
+            workers.emplace_back(sample, i);
+        }
+        sample(0);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // merge in worker order so that the result only depends on the seeds
+    std::set<vector<bool>> unique_list;
+    for (auto& samples : worker_list) {
+        for (auto& row : samples) {
+            if (unique_list.insert(row).second) {
+                out_list.emplace_back(std::move(row));
+            }
+        }
+    }
+}
+
 std::vector<double> CPPOMDP::GetPerceptionLikelihood(const Belief* belief) {
 	const vector<State*>& particles = static_cast<const ParticleBelief*>(belief)->particles();
 	
@@ -318,34 +620,46 @@ std::vector<double> CPPOMDP::GetPerceptionLikelihood(const Belief* belief) {
 	for (int i = 0; i < particles.size(); i++) {
 		State* particle = particles[i];
 		CPState* state = static_cast<CPState*>(particle);
-		for (auto itr=state->risk_bin.begin(), end=state->risk_bin.end(); itr!=end; itr++) {
-			probs[distance(state->risk_bin.begin(), itr)] += *itr * particle->weight;
+		for (int j = 0; j < scenario_.num_targets; j++) {
+			probs[j] += state->GetRisk(j) * particle->weight;
 		}
 	}
     return probs;
 }
 
 
+/* particles are returned to the pool of the worker which frees them,
+ * CPDESPOT allocates and frees each tree under the same worker id.
+ */
+MemoryPool<CPState>* CPPOMDP::WorkerPool() const {
+	int worker_id = CPWorker::Id();
+	return (worker_id < static_cast<int>(memory_pools_.size())) ? memory_pools_[worker_id] : memory_pools_[0];
+}
+
 State* CPPOMDP::Allocate(int state_id, double weight) const {
-	CPState* ras_state = memory_pool.Allocate();
+	CPState* ras_state = WorkerPool()->Allocate();
 	ras_state->state_id = state_id;
 	ras_state->weight = weight;
 	return ras_state;
 }
 
 State* CPPOMDP::Copy(const State* particle) const {
-	CPState* state = memory_pool.Allocate();
+	CPState* state = WorkerPool()->Allocate();
 	*state = *static_cast<const CPState*>(particle);
 	state->SetAllocated();
 	return state;
 }
 
 void CPPOMDP::Free(State* particle) const {
-	memory_pool.Free(static_cast<CPState*>(particle));
+	WorkerPool()->Free(static_cast<CPState*>(particle));
 }
 
 int CPPOMDP::NumActiveParticles() const {
-	return memory_pool.num_allocated();
+	int num = 0;
+	for (auto pool : memory_pools_) {
+		num += pool->num_allocated();
+	}
+	return num;
 }
 
 
@@ -353,12 +667,11 @@ void CPPOMDP::PrintState(const State& state, ostream& out) const {
 	const CPState& ras_state = static_cast<const CPState&>(state);
 	out << "ego_pose : " << ras_state.ego_pose << "\n"
  		<< "ego_speed : " << ras_state.ego_speed << "\n"
- 		<< "ego_recog : " << ras_state.ego_recog << "\n"
+ 		<< "ego_recog : " << CPState::MaskText(ras_state.ego_recog, scenario_.num_targets) << "\n"
  		<< "req_time : " << ras_state.req_time << "\n"
- 		<< "risk_pose : " << ras_state.risk_pose << "\n"
  		<< "req_target : " << ras_state.req_target << "\n"
- 		<< "risk_bin : " << ras_state.risk_bin << "\n"
- 		<< "risk_type : " << ras_state.risk_type << "\n"
+ 		<< "risk_bin : " << CPState::MaskText(ras_state.risk_bin, scenario_.num_targets) << "\n"
+ 		<< scenario_.text()
         << "weight : " << ras_state.weight << "\n"
 	 	<< endl;
 }
@@ -383,8 +696,8 @@ void CPPOMDP::PrintBelief(const Belief& belief, ostream& out) const {
 	for (int i = 0; i < particles.size(); i++) {
 		State* particle = particles[i];
         const CPState* state = static_cast<const CPState*>(particle);
-		for (auto itr=state->risk_bin.begin(), end=state->risk_bin.end(); itr!=end; itr++) {
-			probs[distance(state->risk_bin.begin(), itr)] += *itr * particle-> weight;
+		for (int j = 0; j < scenario_.num_targets; j++) {
+			probs[j] += state->GetRisk(j) * particle->weight;
 		}
 	}
 
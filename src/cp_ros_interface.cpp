@@ -3,24 +3,73 @@
 using std::placeholders::_1;
 using std::placeholders::_2;
 
-CPRosInterface::CPRosInterface()
-    : Node("CPRosInterface")
+CPRosInterface::CPRosInterface(const rclcpp::NodeOptions &options)
+    : Node("CPRosInterface", options)
 {
-    sub_objects_ = this->create_subscription<autoware_auto_perception_msgs::msg::PredictedObjects>("/perception/object_recognition/objects", 10, std::bind(&CPRosInterface::ObjectsCb, this, _1));
-    sub_ego_pose_ = this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>("/localization/pose_with_covariance", 10, std::bind(&CPRosInterface::EgoPoseCb, this, _1));
-    sub_ego_speed_ = this->create_subscription<geometry_msgs::msg::TwistWithCovarianceStamped>("/localization/twist_estimator/twist_with_covariance", 10, std::bind(&CPRosInterface::EgoSpeedCb, this, _1));
-    sub_ego_traj_ = this->create_subscription<autoware_auto_planning_msgs::msg::Trajectory>("/planning/scenario_planning/trajectory", 10, std::bind(&CPRosInterface::EgoTrajectoryCb, this, _1));
-    sub_intervention_ = this->create_subscription<cooperative_perception::msg::CPIntervention>("/cooperative_perception/intervention_result", 10, std::bind(&CPRosInterface::InterventionCb, this, _1));
+    /* perception ingestion, planner services and visualisation each run on their own thread (see StartThreads) */
+    ingestion_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    service_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    publish_group_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive, false);
+    rclcpp::SubscriptionOptions ingestion_options;
+    ingestion_options.callback_group = ingestion_group_;
+    rclcpp::SubscriptionOptions service_options;
+    service_options.callback_group = service_group_;
+
+    sub_objects_ = this->create_subscription<autoware_auto_perception_msgs::msg::PredictedObjects>("/perception/object_recognition/objects", 10, std::bind(&CPRosInterface::ObjectsCb, this, _1), ingestion_options);
+    sub_ego_pose_ = this->create_subscription<geometry_msgs::msg::PoseWithCovarianceStamped>("/localization/pose_with_covariance", 10, std::bind(&CPRosInterface::EgoPoseCb, this, _1), ingestion_options);
+    sub_ego_speed_ = this->create_subscription<geometry_msgs::msg::TwistWithCovarianceStamped>("/localization/twist_estimator/twist_with_covariance", 10, std::bind(&CPRosInterface::EgoSpeedCb, this, _1), ingestion_options);
+    sub_ego_traj_ = this->create_subscription<autoware_auto_planning_msgs::msg::Trajectory>("/planning/scenario_planning/trajectory", 10, std::bind(&CPRosInterface::EgoTrajectoryCb, this, _1), ingestion_options);
+    sub_intervention_ = this->create_subscription<cooperative_perception::msg::CPIntervention>("/cooperative_perception/intervention_result", 10, std::bind(&CPRosInterface::InterventionCb, this, _1), service_options);
 
     pub_objects_ = this->create_publisher<autoware_auto_perception_msgs::msg::PredictedObjects>("/perception/object_recognition/objects_cooperative_perception", 10);
-    pub_cp_object_ = this->create_publisher<cooperative_perception::msg::CPPredictedObject>("/cooperative_perception/object_ue", 10);
+    pub_cp_objects_ = this->create_publisher<cooperative_perception::msg::CPPredictedObjectArray>("/cooperative_perception/object_ue_array", 10);
     pub_intervention_ = this->create_publisher<cooperative_perception::msg::CPIntervention>("/cooperative_perception/intervention_request", 10);
     pub_trajectory_ = this->create_publisher<nav_msgs::msg::Path>("/cooperative_perception/trajectory_path", 10);
+    pub_planner_state_ = this->create_publisher<cooperative_perception::msg::CPPlannerState>("/cooperative_perception/planner_state", 1);
 
-    intervention_service_ = this->create_service<cooperative_perception::srv::Intervention> ("/cooperative_perception/intervention", std::bind(&CPRosInterface::InterventionService, this, _1, _2));
-    current_state_service_ = this->create_service<cooperative_perception::srv::State> ("/cooperative_perception/cp_current_state", std::bind(&CPRosInterface::CurrentStateService, this, _1, _2));
-    update_perception_service_ = this->create_service<cooperative_perception::srv::UpdatePerception> ("/cooperative_perception/cp_updated_target", std::bind(&CPRosInterface::UpdatePerceptionService, this, _1, _2));
+    intervention_service_ = this->create_service<cooperative_perception::srv::Intervention> ("/cooperative_perception/intervention", std::bind(&CPRosInterface::InterventionService, this, _1, _2), rmw_qos_profile_services_default, service_group_);
+    current_state_service_ = this->create_service<cooperative_perception::srv::State> ("/cooperative_perception/cp_current_state", std::bind(&CPRosInterface::CurrentStateService, this, _1, _2), rmw_qos_profile_services_default, service_group_);
+    update_perception_service_ = this->create_service<cooperative_perception::srv::UpdatePerception> ("/cooperative_perception/cp_updated_target", std::bind(&CPRosInterface::UpdatePerceptionService, this, _1, _2), rmw_qos_profile_services_default, service_group_);
+    planner_tick_service_ = this->create_service<cooperative_perception::srv::PlannerTick> ("/cooperative_perception/cp_planner_tick", std::bind(&CPRosInterface::PlannerTickService, this, _1, _2), rmw_qos_profile_services_default, service_group_);
 
+    visualization_timer_ = this->create_wall_timer(std::chrono::duration<double>(visualization_period_), std::bind(&CPRosInterface::VisualizationCb, this), publish_group_);
+
+    /* every tracker slot is allocated here, ObjectsCb only reuses them */
+    objects_.Reserve(max_objects_);
+
+    /* object workers, clipped to the hardware concurrency */
+    int num_hw_threads = std::thread::hardware_concurrency();
+    if (num_hw_threads > 0) num_object_workers_ = std::min(num_object_workers_, num_hw_threads);
+
+    StartThreads();
+}
+
+CPRosInterface::~CPRosInterface()
+{
+    /* no callback may run while the members go away */
+    ingestion_thread_.Stop();
+    service_thread_.Stop();
+    publish_thread_.Stop();
+}
+
+
+/* thread per callback group, priority and cores from the parameters
+ * ingestion.*, service.* and publish.* (see CPThreadConfig).
+ * the worker pools of ObjectsCb and VisualizationCb get the setting of their group.
+ */
+void CPRosInterface::StartThreads()
+{
+    CPThreadConfig ingestion_config = CPThreadConfig::Declare(this, "ingestion");
+    CPThreadConfig service_config = CPThreadConfig::Declare(this, "service");
+    CPThreadConfig publish_config = CPThreadConfig::Declare(this, "publish");
+
+    /* pools first, the callbacks use them as soon as the executors run */
+    ingestion_pool_.Start(num_object_workers_, ingestion_config);
+    publish_pool_.Start(num_object_workers_, publish_config);
+
+    ingestion_thread_.Start(ingestion_group_, this->get_node_base_interface(), ingestion_config);
+    service_thread_.Start(service_group_, this->get_node_base_interface(), service_config);
+    publish_thread_.Start(publish_group_, this->get_node_base_interface(), publish_config);
 }
 
 void CPRosInterface::EgoPoseCb(const geometry_msgs::msg::PoseWithCovarianceStamped::SharedPtr msg) 
@@ -33,22 +82,35 @@ void CPRosInterface::EgoSpeedCb(const geometry_msgs::msg::TwistWithCovarianceSta
 {
     // std::cout << "get speed " << std::endl;
     ego_speed_ = (*msg).twist.twist;
+    /* ego_speed is part of the planner state, the pose only enters with the next objects.
+     * at odometry rate the snapshot is only rebuilt for a real speed change, smaller ones go out with the next objects
+     */
+    if (std::fabs(ego_speed_.linear.x - published_ego_speed_) < speed_publish_threshold_) return;
+    PublishSnapshot();
 }
 
-void CPRosInterface::EgoTrajectoryCb(const autoware_auto_planning_msgs::msg::Trajectory::SharedPtr msg) 
+void CPRosInterface::EgoTrajectoryCb(const autoware_auto_planning_msgs::msg::Trajectory::ConstSharedPtr msg) 
 {
     // std::cout << "get trajectory" << std::endl;
-    ego_trajectory_ = *msg;
+    ego_trajectory_ = msg;
+
+    /* the planner republishes the same trajectory at its own rate, only a moved one is re-indexed
+     * and re-evaluates the objects
+     */
+    uint64_t trajectory_hash = HashTrajectory(*msg);
+    if (trajectory_generation_ > 0 && trajectory_hash == trajectory_hash_) return;
+    trajectory_hash_ = trajectory_hash;
 
-    /* join trajectory for rclUE */
-    nav_msgs::msg::Path path;
-    path.header = msg->header;
+    trajectory_xs_.clear();
+    trajectory_ys_.clear();
     for (const auto &point : msg->points) {
-        geometry_msgs::msg::PoseStamped buf_pose;
-        buf_pose.pose = point.pose;
-        path.poses.emplace_back(buf_pose);
+        trajectory_xs_.emplace_back(point.pose.position.x);
+        trajectory_ys_.emplace_back(point.pose.position.y);
     }
-    pub_trajectory_->publish(path);
+    trajectory_index_.Build(trajectory_xs_, trajectory_ys_, collision_thres_);
+    trajectory_generation_++;
+
+    PublishSnapshot();
 }
 
 void CPRosInterface::InterventionCb(const cooperative_perception::msg::CPIntervention::SharedPtr msg)
@@ -56,70 +118,213 @@ void CPRosInterface::InterventionCb(const cooperative_perception::msg::CPInterve
     intervention_result_ = *msg;
 }
 
-void CPRosInterface::ObjectsCb(const autoware_auto_perception_msgs::msg::PredictedObjects::SharedPtr msg) 
+void CPRosInterface::ObjectsCb(const autoware_auto_perception_msgs::msg::PredictedObjects::ConstSharedPtr msg) 
 {
+    const int num_msg_objects = msg->objects.size();
+    ApplyLikelihoodUpdates();
 
-    /* store and manage objects */
-    for (const auto &msg_obj : msg->objects) {
-        std::string object_id = despot::CPRosTools().ConvertUUIDtoIntString(msg_obj.object_id.uuid);
+    /* collision points are measured from the ego vehicle, which moves even when nothing else changes */
+    double ego_offset = 0.0;
+    if (trajectory_index_.Size() > 0) {
+        ego_offset = std::hypot(trajectory_index_.X(0) - ego_pose_.position.x, trajectory_index_.Y(0) - ego_pose_.position.y);
+    }
 
-        /* new object */
-        if (objects_.count(object_id) == 0) {
-            Object buf_obj;
-            buf_obj.predicted_object = msg_obj;
-            buf_obj.decay_time = 0;
-            GetCollisionPointAndRisk(ego_trajectory_, msg_obj.kinematics, buf_obj.collision_prob, buf_obj.collision_point, buf_obj.collision_path_index);
-            objects_[object_id] = buf_obj;
+    /* objects not seen for object_timeout_ by the message clock are dropped first, so their slots are free.
+     * a stamp far behind the objects (replayed bag, restarted simulator) drops them as well
+     */
+    double stamp = rclcpp::Time(msg->header.stamp).seconds();
+    if (stamp == 0.0) stamp = this->now().seconds();
+    for (int i = 0; i < objects_.Size();) {
+        double age = stamp - objects_.ValueAt(i).last_seen;
+        if (age > object_timeout_ || age < -object_timeout_) {
+            objects_.EraseAt(i);
+            continue;
         }
-        /* update object info */
-        else {
-            Object &buf_obj = objects_[object_id];
-            buf_obj.predicted_object = msg_obj;
-            double collision_prob;
-            GetCollisionPointAndRisk(ego_trajectory_, msg_obj.kinematics, collision_prob, buf_obj.collision_point, buf_obj.collision_path_index);
+        ++i;
+    }
+
+    /* find or insert the objects (serial, objects_ is not touched by the workers).
+     * positions in objects_ stay valid while inserting, an id appearing twice in one message
+     * is updated by its last entry only. new objects beyond max_objects_ are ignored
+     */
+    std::vector<int> &targets = batch_targets_;
+    std::vector<uint8_t> &is_new = batch_is_new_;
+    targets.assign(num_msg_objects, -1);
+    is_new.assign(num_msg_objects, 0);
+    int num_dropped = 0;
+    for (int i = 0; i < num_msg_objects; ++i) {
+        CPUuid uuid(msg->objects[i].object_id.uuid);
+        targets[i] = objects_.Find(uuid);
+        if (targets[i] >= 0) continue;
+        if (objects_.Size() >= max_objects_) {
+            num_dropped++;
+            continue;
         }
+        targets[i] = objects_.Insert(uuid);
+        is_new[i] = 1;
+    }
+    if (num_dropped > 0) {
+        RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "[ObjectsCb] tracker full (%d), ignored %d new objects", max_objects_, num_dropped);
     }
 
-    /* publish objects for rclUE */
-    autoware_auto_perception_msgs::msg::PredictedObjects out_auto_msg;
+    std::vector<int> &last_entry = batch_last_entry_;
+    last_entry.assign(objects_.Size(), -1);
+    for (int i = 0; i < num_msg_objects; ++i) {
+        if (targets[i] < 0) continue;
+        int &last = last_entry[targets[i]];
+        if (last >= 0) {
+            is_new[i] = is_new[last];
+            targets[last] = -1;
+        }
+        last = i;
+    }
 
-    for (auto itr = objects_.begin(), end = objects_.end() ; itr != end;) {
-        /* update decay time */
-        itr->second.decay_time++;
-        if (itr->second.decay_time > 5.0) {
-            itr = objects_.erase(itr);
-            continue;
+    /* store and evaluate objects (parallel, every entry writes only its own Object) */
+    std::vector<uint8_t> &is_evaluated = batch_is_evaluated_;
+    is_evaluated.assign(num_msg_objects, 0);
+    ParallelFor(ingestion_pool_, num_msg_objects, [&](const int i) {
+        if (targets[i] < 0) return;
+        const auto &msg_obj = msg->objects[i];
+        Object &buf_obj = objects_.ValueAt(targets[i]);
+        uint64_t path_hash = HashPredictedPaths(msg_obj.kinematics);
+
+        buf_obj.source = msg;
+        buf_obj.source_index = i;
+        buf_obj.last_seen = stamp;
+
+        /* new object */
+        if (is_new[i]) {
+            buf_obj.collision_prob = 0.0;
+            buf_obj.collision_point = 0.0;
+            buf_obj.collision_path_index = 0;
+            buf_obj.collision_arc = -1.0;
+            buf_obj.trajectory_generation = trajectory_generation_;
+            buf_obj.path_hash = path_hash;
+            GetCollisionPointAndRisk(msg_obj.kinematics, buf_obj.collision_prob, buf_obj.collision_arc, buf_obj.collision_path_index);
+            is_evaluated[i] = 1;
+        }
+        /* update object info, re-evaluate only if its paths or the trajectory changed */
+        else {
+            if (buf_obj.path_hash != path_hash || buf_obj.trajectory_generation != trajectory_generation_) {
+                double collision_prob;
+                GetCollisionPointAndRisk(msg_obj.kinematics, collision_prob, buf_obj.collision_arc, buf_obj.collision_path_index);
+                buf_obj.trajectory_generation = trajectory_generation_;
+                buf_obj.path_hash = path_hash;
+                is_evaluated[i] = 1;
+            }
         }
 
-        /* autoware perception msg */
-        autoware_auto_perception_msgs::msg::PredictedObject auto_obj = itr->second.predicted_object;
-        auto_obj.kinematics.predicted_paths[itr->second.collision_path_index].confidence = itr->second.collision_prob;
-        out_auto_msg.objects.emplace_back(auto_obj);
-
-        /* pub rclre object msgs */
-        cooperative_perception::msg::CPPredictedObject out_cp_msg;
-        out_cp_msg.object_id = itr->second.predicted_object.object_id;
-        out_cp_msg.existence_probability = itr->second.predicted_object.existence_probability;
-        out_cp_msg.pose = itr->second.predicted_object.kinematics.initial_pose_with_covariance.pose;
-        out_cp_msg.dimension = itr->second.predicted_object.shape.dimensions;
-        for (const auto& classification : itr->second.predicted_object.classification) {
-            out_cp_msg.classifications.emplace_back(classification.label);
-            out_cp_msg.classification_confidences.emplace_back(classification.probability);
+        if (buf_obj.collision_arc >= 0.0) {
+            buf_obj.collision_point = ego_offset + buf_obj.collision_arc;
         }
+    });
+    int num_evaluated = std::count(is_evaluated.begin(), is_evaluated.end(), 1);
+    RCLCPP_DEBUG(this->get_logger(), "[ObjectsCb] evaluated collision of %d / %d objects", num_evaluated, num_msg_objects);
+
+    /* autoware perception msg with the updated confidence (parallel, one slot per object) */
+    const int num_out_objects = objects_.Size();
+    auto out_auto_msg = std::make_unique<autoware_auto_perception_msgs::msg::PredictedObjects>();
+    out_auto_msg->header = msg->header;
+    out_auto_msg->objects.resize(num_out_objects);
+    ParallelFor(ingestion_pool_, num_out_objects, [&](const int i) {
+        const Object &obj = objects_.ValueAt(i);
+        const int path_index = obj.collision_path_index;
+        autoware_auto_perception_msgs::msg::PredictedObject &auto_obj = out_auto_msg->objects[i];
+        auto_obj = obj.Predicted();
+        if (path_index < int(auto_obj.kinematics.predicted_paths.size())) {
+            auto_obj.kinematics.predicted_paths[path_index].confidence = obj.collision_prob;
+        }
+    });
+    pub_objects_->publish(std::move(out_auto_msg));
+
+    objects_header_ = msg->header;
+    objects_generation_++;
+    PublishSnapshot();
+}
+
 
-        for (const auto& path : itr->second.predicted_object.kinematics.predicted_paths) {
-            out_cp_msg.pathes.insert(out_cp_msg.pathes.end(), path.path.begin(), path.path.end());
-            geometry_msgs::msg::Pose separator;
-            out_cp_msg.pathes.emplace_back(separator);
-            out_cp_msg.path_confidences.emplace_back(path.confidence);
+/* rclUE output at visualization_period_ regardless of the perception rate.
+ * runs on the publish thread and reads only the visualisation snapshot. messages are built
+ * only when someone listens and something changed since the last publish.
+ */
+void CPRosInterface::VisualizationCb()
+{
+    vis_snapshot_.Update();
+    const Snapshot &snapshot = vis_snapshot_.Front();
+
+    /* joined trajectory */
+    if (snapshot.trajectory != nullptr && visualized_trajectory_generation_ != snapshot.trajectory_generation && pub_trajectory_->get_subscription_count() > 0) {
+        auto path = std::make_unique<nav_msgs::msg::Path>();
+        path->header = snapshot.trajectory->header;
+        path->poses.resize(snapshot.trajectory->points.size());
+        for (size_t i = 0; i < snapshot.trajectory->points.size(); ++i) {
+            path->poses[i].pose = snapshot.trajectory->points[i].pose;
         }
-        out_cp_msg.path_confidences[itr->second.collision_path_index] = itr->second.collision_prob;
-        pub_cp_object_->publish(out_cp_msg);
+        pub_trajectory_->publish(std::move(path));
+        visualized_trajectory_generation_ = snapshot.trajectory_generation;
+    }
+
+    /* all objects in one message (parallel, one slot per object) */
+    if (visualized_objects_generation_ != snapshot.objects_generation && pub_cp_objects_->get_subscription_count() > 0) {
+        const int num_objects = snapshot.objects.size();
+        auto out_cp_msg = std::make_unique<cooperative_perception::msg::CPPredictedObjectArray>();
+        out_cp_msg->header = snapshot.objects_header;
+        out_cp_msg->objects.resize(num_objects);
+        ParallelFor(publish_pool_, num_objects, [&](const int i) {
+            const Snapshot::Entry &entry = snapshot.objects[i];
+            const autoware_auto_perception_msgs::msg::PredictedObject &predicted = entry.source->objects[entry.source_index];
+            cooperative_perception::msg::CPPredictedObject &cp_obj = out_cp_msg->objects[i];
+            cp_obj.header = snapshot.objects_header;
+            cp_obj.object_id = predicted.object_id;
+            cp_obj.existence_probability = predicted.existence_probability;
+            cp_obj.pose = predicted.kinematics.initial_pose_with_covariance.pose;
+            cp_obj.dimension = predicted.shape.dimensions;
+
+            cp_obj.classifications.reserve(predicted.classification.size());
+            cp_obj.classification_confidences.reserve(predicted.classification.size());
+            for (const auto& classification : predicted.classification) {
+                cp_obj.classifications.emplace_back(classification.label);
+                cp_obj.classification_confidences.emplace_back(classification.probability);
+            }
 
-        ++itr;
+            /* paths joined by an empty pose */
+            size_t num_poses = 0;
+            for (const auto& path : predicted.kinematics.predicted_paths) {
+                num_poses += path.path.size() + 1;
+            }
+            cp_obj.pathes.reserve(num_poses);
+            cp_obj.path_confidences.reserve(predicted.kinematics.predicted_paths.size());
+            for (const auto& path : predicted.kinematics.predicted_paths) {
+                cp_obj.pathes.insert(cp_obj.pathes.end(), path.path.begin(), path.path.end());
+                cp_obj.pathes.emplace_back();
+                cp_obj.path_confidences.emplace_back(path.confidence);
+            }
+            if (entry.collision_path_index < int(cp_obj.path_confidences.size())) {
+                cp_obj.path_confidences[entry.collision_path_index] = entry.collision_prob;
+            }
+        });
+        pub_cp_objects_->publish(std::move(out_cp_msg));
+        visualized_objects_generation_ = snapshot.objects_generation;
     }
+}
 
-    pub_objects_->publish(out_auto_msg);
+
+/* run func(i) for i in [0, num) in contiguous chunks on the callback thread and the pool of its group.
+ * each index is handled by exactly one thread, so writes to per-index slots need no locking.
+ * small batches stay on the callback thread where waking the pool costs more than it saves.
+ */
+void CPRosInterface::ParallelFor(CPWorkerPool &pool, const int num, const std::function<void(const int)> &func) const
+{
+    int num_threads = std::min(pool.NumThreads(), num / min_objects_per_worker_);
+    if (num_threads <= 1) {
+        for (int i = 0; i < num; ++i) func(i);
+        return;
+    }
+
+    int chunk = (num + num_threads - 1) / num_threads;
+    pool.Run(num_threads, [&func, chunk, num](const int t) {
+        for (int i = t * chunk, end = std::min(num, (t + 1) * chunk); i < end; ++i) func(i);
+    });
 }
 
 
@@ -127,15 +332,7 @@ void CPRosInterface::ObjectsCb(const autoware_auto_perception_msgs::msg::Predict
 void CPRosInterface::InterventionService(const std::shared_ptr<cooperative_perception::srv::Intervention::Request> request, std::shared_ptr<cooperative_perception::srv::Intervention::Response> response)
 {
     RCLCPP_INFO(this->get_logger(), "[InterventionService] sending intervention request");
-    std::string object_id = despot::CPRosTools().ConvertUUIDtoIntString(request->object_id.uuid);
-
-    if (objects_.count(object_id) != 0) {
-        cooperative_perception::msg::CPIntervention out_msg;
-        out_msg.object_id = request->object_id;
-        out_msg.distance = objects_[object_id].collision_point;
-        out_msg.path_index = objects_[object_id].collision_path_index;
-        pub_intervention_->publish(out_msg);
-    }
+    SendIntervention(request->object_id);
 
     RCLCPP_INFO(this->get_logger(), "[InterventionService] sending intervention result");
     /*TODO change id to intervention result
@@ -151,88 +348,263 @@ void CPRosInterface::CurrentStateService(const std::shared_ptr<cooperative_perce
     if (!request->request) return;
     // RCLCPP_INFO(this->get_logger(), "[CurrentStateService] creating current state");
 
-    std::vector<int> distances; 
-    std::vector<double> probs;
-    std::vector<unique_identifier_msgs::msg::UUID> ids;
-    std::vector<std_msgs::msg::String> types;
+    response->header.stamp = this->now();
+    response->applied_seq = likelihood_seq_;
+    GetState(ReadSnapshot(), &pending_likelihood_, response->object_id, response->ego_speed, response->risk_pose, response->likelihood, response->type);
+}
 
-    for (const auto &obj: objects_)
-    {
-        std::stringstream ss;
-        ss << "[CurrentStateService] creating current state of " 
-           << obj.first;
-        RCLCPP_INFO(this->get_logger(), ss.str().c_str());
 
+/* one planner step in a single round trip.
+ * likelihoods of the last belief update are applied first, then the intervention
+ * of the chosen action is sent, and the state for the next step is returned.
+ */
+void CPRosInterface::PlannerTickService(const std::shared_ptr<cooperative_perception::srv::PlannerTick::Request> request, std::shared_ptr<cooperative_perception::srv::PlannerTick::Response> response)
+{
+    for (size_t i = 0; i < request->update_object_id.size() && i < request->update_likelihood.size(); i++) {
+        SetLikelihood(request->update_object_id[i], request->update_likelihood[i]);
+    }
+
+    if (request->has_action) {
+        RCLCPP_INFO(this->get_logger(), "[PlannerTickService] sending intervention request");
+        SendIntervention(request->object_id);
+        response->result_object_id = request->object_id;
+        response->result = intervention_result_.intervention;
+    }
+
+    /* the state contains the pending likelihoods, so every update queued so far */
+    response->header.stamp = this->now();
+    response->applied_seq = likelihood_seq_;
+    GetState(ReadSnapshot(), &pending_likelihood_, response->object_id, response->ego_speed, response->risk_pose, response->likelihood, response->type);
+    PublishPlannerState();
+}
+
+
+void CPRosInterface::SendIntervention(const unique_identifier_msgs::msg::UUID &object_id)
+{
+    const Snapshot &snapshot = ReadSnapshot();
+    const int *idx = snapshot.index.Get(CPUuid(object_id.uuid));
+
+    if (idx != nullptr) {
+        cooperative_perception::msg::CPIntervention out_msg;
+        out_msg.object_id = object_id;
+        out_msg.distance = snapshot.objects[*idx].collision_point;
+        out_msg.path_index = snapshot.objects[*idx].collision_path_index;
+        pub_intervention_->publish(out_msg);
+    }
+}
+
+
+/* queue the likelihood for ObjectsCb and keep it as pending until a snapshot contains it.
+ * likelihood_seq_ counts the queued updates, states report the last one they contain (applied_seq)
+ */
+bool CPRosInterface::SetLikelihood(const unique_identifier_msgs::msg::UUID &object_id, const double likelihood)
+{
+    CPUuid uuid(object_id.uuid);
+    LikelihoodUpdate update = {uuid, likelihood, likelihood_seq_ + 1};
+    if (!likelihood_queue_.Push(update)) {
+        RCLCPP_WARN(this->get_logger(), "[SetLikelihood] likelihood queue is full");
+        return false;
+    }
+    likelihood_seq_ = update.seq;
+    pending_likelihood_[uuid] = update;
+    return ReadSnapshot().index.Find(uuid) >= 0;
+}
+
+
+/* services: latest snapshot, pending likelihoods it already contains are dropped */
+const CPRosInterface::Snapshot& CPRosInterface::ReadSnapshot()
+{
+    snapshot_.Update();
+    const Snapshot &snapshot = snapshot_.Front();
+    for (int i = 0; i < pending_likelihood_.Size();) {
+        if (pending_likelihood_.ValueAt(i).seq <= snapshot.applied_seq) {
+            pending_likelihood_.EraseAt(i);
+        }
+        else {
+            ++i;
+        }
+    }
+    return snapshot;
+}
+
+
+/* services: push the planner state after a likelihood update */
+void CPRosInterface::PublishPlannerState()
+{
+    std::lock_guard<std::mutex> lock(planner_state_mutex_);
+    auto out_msg = std::make_unique<cooperative_perception::msg::CPPlannerState>();
+    out_msg->header.stamp = this->now();
+    out_msg->applied_seq = likelihood_seq_;
+    GetState(ReadSnapshot(), &pending_likelihood_, out_msg->object_id, out_msg->ego_speed, out_msg->risk_pose, out_msg->likelihood, out_msg->type);
+    pub_planner_state_->publish(std::move(out_msg));
+}
+
+
+/* ingestion: likelihoods queued by the services */
+void CPRosInterface::ApplyLikelihoodUpdates()
+{
+    LikelihoodUpdate update;
+    while (likelihood_queue_.Pop(update)) {
+        Object *obj = objects_.Get(update.uuid);
+        if (obj != nullptr) {
+            obj->collision_prob = update.likelihood;
+            objects_generation_++;
+        }
+        applied_likelihood_seq_ = update.seq;
+    }
+}
+
+
+/* ingestion: hand the object table to the services and the publish thread, and push the planner state.
+ * the snapshots are built without the lock, it only orders the planner state message against the
+ * one of the services. either message carries the applied_seq of its likelihoods.
+ */
+void CPRosInterface::PublishSnapshot()
+{
+    ApplyLikelihoodUpdates();
+
+    Snapshot &snapshot = snapshot_.Back();
+    snapshot.objects.clear();
+    snapshot.index.Clear();
+    for (int i = 0; i < objects_.Size(); ++i) {
+        const Object &obj = objects_.ValueAt(i);
+        snapshot.index[objects_.KeyAt(i)] = snapshot.objects.size();
+        snapshot.objects.push_back({obj.Predicted().object_id, obj.collision_point, obj.collision_prob, obj.collision_path_index, obj.source, obj.source_index});
+    }
+    snapshot.ego_speed = ego_speed_.linear.x;
+    published_ego_speed_ = snapshot.ego_speed;
+    snapshot.applied_seq = applied_likelihood_seq_;
+    snapshot.objects_header = objects_header_;
+    snapshot.objects_generation = objects_generation_;
+    snapshot.trajectory = ego_trajectory_;
+    snapshot.trajectory_generation = trajectory_generation_;
+
+    /* same content for the publish thread, assignment reuses the capacity of its buffer */
+    vis_snapshot_.Back() = snapshot;
+    vis_snapshot_.Publish();
+
+    auto out_msg = std::make_unique<cooperative_perception::msg::CPPlannerState>();
+    std::lock_guard<std::mutex> lock(planner_state_mutex_);
+    out_msg->header.stamp = this->now();
+    out_msg->applied_seq = snapshot.applied_seq;
+    GetState(snapshot, nullptr, out_msg->object_id, out_msg->ego_speed, out_msg->risk_pose, out_msg->likelihood, out_msg->type);
+    snapshot_.Publish();
+    pub_planner_state_->publish(std::move(out_msg));
+}
+
+
+/* planner state of a snapshot, pending likelihoods (services only) override the snapshot */
+void CPRosInterface::GetState(const Snapshot &snapshot, const CPUuidTable<LikelihoodUpdate> *pending, std::vector<unique_identifier_msgs::msg::UUID> &ids, double &ego_speed, std::vector<int> &distances, std::vector<double> &probs, std::vector<std_msgs::msg::String> &types) const
+{
+    ids.reserve(ids.size() + snapshot.objects.size());
+    distances.reserve(distances.size() + snapshot.objects.size());
+    probs.reserve(probs.size() + snapshot.objects.size());
+    types.reserve(types.size() + snapshot.objects.size());
+    for (const auto &entry : snapshot.objects)
+    {
         /* no collision point -> ignore it */
-        if (obj.second.collision_point == 0.0) continue;
+        if (entry.collision_point == 0.0) continue;
 
-        distances.emplace_back(int(obj.second.collision_point));
-        probs.emplace_back(obj.second.collision_prob);
-        ids.emplace_back(obj.second.predicted_object.object_id);
+        double prob = entry.collision_prob;
+        if (pending != nullptr) {
+            const LikelihoodUpdate *update = pending->Get(CPUuid(entry.object_id.uuid));
+            if (update != nullptr) prob = update->likelihood;
+        }
+
+        distances.emplace_back(int(entry.collision_point));
+        probs.emplace_back(prob);
+        ids.emplace_back(entry.object_id);
         std_msgs::msg::String buf_type;
         buf_type.data = "hard";
         // buf_type.data = std::string(obj.second.predicted_object.classification[0].label);
-        types.emplace_back(buf_type);
+        types.emplace_back(std::move(buf_type));
     }
 
-    response->risk_pose = distances;
-    response->likelihood = probs;
-    response->ego_speed = ego_speed_.linear.x;
-    response->object_id = ids;
-    response->type = types;
+    ego_speed = snapshot.ego_speed;
 }
 
-void CPRosInterface::GetCollisionPointAndRisk(const autoware_auto_planning_msgs::msg::Trajectory &ego_traj, const autoware_auto_perception_msgs::msg::PredictedObjectKinematics &obj_kinematics, double &collision_prob, double &collision_point, int &path_index) const
+
+/* first trajectory point (from the ego side) which one of the predicted paths passes within collision_thres_.
+ * every path pose is a radius query on trajectory_index_, the first path reaching that point wins.
+ */
+void CPRosInterface::GetCollisionPointAndRisk(const autoware_auto_perception_msgs::msg::PredictedObjectKinematics &obj_kinematics, double &collision_prob, double &collision_arc, int &path_index) const
 {
-    float thres = 3.0; // [m]
-    float accumulated_dist = 0.0;
-    for (int i=0; i<int(sizeof(ego_traj.points)/sizeof(autoware_auto_planning_msgs::msg::TrajectoryPoint)); ++i)
-    {
-        /* object position is crossing point to ego vehicle trajectory
-         * get distance from trajectory */
-        const geometry_msgs::msg::Pose &ego_traj_pose = ego_traj.points[i].pose;
-        if (i == 0) {
-            accumulated_dist += sqrt(pow(ego_traj_pose.position.x - ego_pose_.position.x, 2) + pow(ego_traj_pose.position.y - ego_pose_.position.y, 2));
-        } 
-        else {
-            accumulated_dist += sqrt(pow(ego_traj_pose.position.x - ego_traj.points[i-1].pose.position.x, 2) + pow(ego_traj_pose.position.y - ego_traj.points[i-1].pose.position.y, 2));
+    /* index is built from the trajectory stored in EgoTrajectoryCb */
+    if (trajectory_index_.Size() == 0) return;
+
+    int traj_index = -1;
+    int hit_path = -1;
+    for (int j=0; j<int(obj_kinematics.predicted_paths.size()); ++j) {
+        /* a later path only wins with a strictly earlier trajectory point */
+        int limit = (traj_index < 0) ? trajectory_index_.Size() : traj_index;
+        for (const auto &obj_pose : obj_kinematics.predicted_paths[j].path) {
+            int i = trajectory_index_.FirstWithin(obj_pose.position.x, obj_pose.position.y, collision_thres_, limit);
+            if (i < 0) continue;
+            traj_index = i;
+            hit_path = j;
+            limit = i;
+            if (i == 0) break;
         }
+        if (traj_index == 0) break;
+    }
+    if (traj_index < 0) return;
 
-        /* calculate crossing point */
-        for (int j=0; j<int(sizeof(obj_kinematics.predicted_paths)/sizeof(autoware_auto_perception_msgs::msg::PredictedPath)); ++j) {
-            for (int k=0; k<int(sizeof(obj_kinematics.predicted_paths[j].path)/sizeof(geometry_msgs::msg::Pose)); ++k) {
-                const geometry_msgs::msg::Pose &obj_pose = obj_kinematics.predicted_paths[j].path[k];
-
-                float dist = sqrt(pow(obj_pose.position.x - ego_traj_pose.position.x, 2) + pow(obj_pose.position.y - ego_traj_pose.position.y, 2));
-                if (dist < thres) {
-                    collision_point = accumulated_dist;
-                    collision_prob = obj_kinematics.predicted_paths[j].confidence;
-                    path_index = j;
-                    return;
-                }
-            }
+    /* the caller adds the distance from the ego vehicle to the first trajectory point */
+    collision_arc = trajectory_index_.ArcLength(traj_index);
+    collision_prob = obj_kinematics.predicted_paths[hit_path].confidence;
+    path_index = hit_path;
+}
+
+/* FNV-1a over path count, confidences and poses quantised to path_hash_resolution_.
+ * a parked car whose prediction only jitters keeps its hash.
+ */
+uint64_t CPRosInterface::HashPredictedPaths(const autoware_auto_perception_msgs::msg::PredictedObjectKinematics &obj_kinematics) const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const int64_t value) {
+        hash ^= uint64_t(value);
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 32;
+    };
+
+    mix(obj_kinematics.predicted_paths.size());
+    for (const auto &path : obj_kinematics.predicted_paths) {
+        mix(path.path.size());
+        mix(std::llround(path.confidence * 1000.0));
+        for (const auto &pose : path.path) {
+            mix(std::llround(pose.position.x / path_hash_resolution_));
+            mix(std::llround(pose.position.y / path_hash_resolution_));
         }
     }
+    return hash;
 }
 
-void CPRosInterface::UpdatePerceptionService(const std::shared_ptr<cooperative_perception::srv::UpdatePerception::Request> request, std::shared_ptr<cooperative_perception::srv::UpdatePerception::Response> response)
+/* FNV-1a over the trajectory points quantised to path_hash_resolution_, as HashPredictedPaths */
+uint64_t CPRosInterface::HashTrajectory(const autoware_auto_planning_msgs::msg::Trajectory &trajectory) const
 {
-    RCLCPP_INFO(this->get_logger(), "[UpdatePerceptionService] sending updated perception");
-    std::string object_id = despot::CPRosTools().ConvertUUIDtoIntString(request->object_id.uuid);
-
-    if (objects_.count(object_id) != 0) {
-        objects_[object_id].collision_prob = request->likelihood;
-        response->result = true;
-        return;
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const int64_t value) {
+        hash ^= uint64_t(value);
+        hash *= 1099511628211ULL;
+        hash ^= hash >> 32;
+    };
+
+    mix(trajectory.points.size());
+    for (const auto &point : trajectory.points) {
+        mix(std::llround(point.pose.position.x / path_hash_resolution_));
+        mix(std::llround(point.pose.position.y / path_hash_resolution_));
     }
-    response->result = false;
+    return hash;
 }
 
-
-int main(int argc, char* argv[])
+void CPRosInterface::UpdatePerceptionService(const std::shared_ptr<cooperative_perception::srv::UpdatePerception::Request> request, std::shared_ptr<cooperative_perception::srv::UpdatePerception::Response> response)
 {
-    rclcpp::init(argc, argv);
-    rclcpp::spin(std::make_shared<CPRosInterface>());
-    rclcpp::shutdown();
-    return 0;
+    RCLCPP_INFO(this->get_logger(), "[UpdatePerceptionService] sending updated perception");
+    response->result = SetLikelihood(request->object_id, request->likelihood);
+    response->applied_seq = likelihood_seq_;
+    PublishPlannerState();
 }
+
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(CPRosInterface)
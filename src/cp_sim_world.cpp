@@ -0,0 +1,209 @@
+#include "cooperative_perception/cp_sim_world.hpp"
+#include "cooperative_perception/cp_json.hpp"
+
+bool CPSimConfig::Load(const std::string &path, CPSimConfig &config)
+{
+    CPJson json;
+    std::string error;
+    if (!CPJson::Load(path, json, error)) {
+        std::cout << "[cp_sim_world::Load] " << path << ": " << error << std::endl;
+        return false;
+    }
+
+    const CPJson *likelihood = json.Get("risk_likelihood");
+    const CPJson *pose = json.Get("risk_pose");
+    if (likelihood == nullptr || pose == nullptr || likelihood->array.size() != pose->array.size()) {
+        std::cout << "[cp_sim_world::Load] " << path << ": risk_likelihood and risk_pose of the same size are required" << std::endl;
+        return false;
+    }
+    if (pose->array.size() > CP_MAX_TARGETS) {
+        std::cout << "[cp_sim_world::Load] " << path << ": more than " << CP_MAX_TARGETS << " targets" << std::endl;
+        return false;
+    }
+
+    config = CPSimConfig();
+    if (json.Get("delta_t") != nullptr) config.delta_t = json.Get("delta_t")->number;
+    if (json.Get("time_per_move") != nullptr) config.time_per_move = json.Get("time_per_move")->number;
+    for (size_t i = 0; i < pose->array.size(); i++) {
+        config.risk_likelihood.emplace_back(likelihood->array[i].number);
+        config.risk_pose.emplace_back(static_cast<int>(pose->array[i].number));
+    }
+
+    const CPJson *type = json.Get("risk_type");
+    for (size_t i = 0; i < pose->array.size(); i++) {
+        bool has_type = type != nullptr && i < type->array.size();
+        config.risk_type.emplace_back(has_type ? type->array[i].string : "hard");
+    }
+    return true;
+}
+
+
+CPSimWorld::CPSimWorld(const CPSimConfig &config, const unsigned seed, const int planning_horizon, const double risk_thresh)
+    : config_(config),
+      planning_horizon_(planning_horizon),
+      risk_thresh_(risk_thresh),
+      random_(seed)
+{
+    true_state_ = new CPState();
+    cp_state_ = new CPState();
+    cp_scenario_ = new CPScenario();
+    for (size_t i = 0; i < config_.risk_pose.size(); i++) {
+        cp_scenario_->AddTarget(config_.risk_pose[i], CPTypeTable::GetId(config_.risk_type[i]));
+    }
+    /* sorted like the copy in reward_model_, both share the layout_id of the transition cache */
+    cp_scenario_->SortTargets();
+    cp_values_ = new CPValues(cp_scenario_->num_targets);
+
+    vehicle_model_ = new VehicleModel(config_.delta_t);
+    operator_model_ = new OperatorModel();
+    operator_model_->CompileAccuracyTable(planning_horizon_);
+    reward_model_ = new CPPOMDP(planning_horizon_, risk_thresh_, config_.delta_t, vehicle_model_, operator_model_, cp_scenario_);
+}
+
+CPSimWorld::~CPSimWorld()
+{
+    delete reward_model_;
+    delete operator_model_;
+    delete vehicle_model_;
+    delete cp_values_;
+    delete cp_scenario_;
+    delete cp_state_;
+    delete true_state_;
+}
+
+
+bool CPSimWorld::Connect()
+{
+    return true;
+}
+
+
+/* new episode: ego at the start with max speed, hidden risk sampled from the likelihood */
+State* CPSimWorld::Initialize()
+{
+    *true_state_ = CPState();
+    true_state_->ego_speed = vehicle_model_->max_speed_;
+    for (int i = 0; i < cp_scenario_->num_targets; i++) {
+        true_state_->SetRisk(i, random_.NextDouble() < config_.risk_likelihood[i]);
+    }
+    likelihood_ = config_.risk_likelihood;
+
+    id_idx_list_.clear();
+    req_target_history_.clear();
+    prev_idx_list_.clear();
+    for (int i = 0; i < cp_scenario_->num_targets; i++) {
+        unique_identifier_msgs::msg::UUID uuid;
+        uuid.uuid.fill(0);
+        uuid.uuid[0] = static_cast<uint8_t>(i + 1);
+        id_idx_list_[i] = uuid;
+        prev_idx_list_.emplace_back(i);
+    }
+    is_target_changed_ = true;
+    step_reward_ = 0.0;
+
+    *cp_state_ = *true_state_;
+    return cp_state_;
+}
+
+
+State* CPSimWorld::GetCurrentState()
+{
+    return cp_state_;
+}
+
+
+/* state seen by the planner: the risk is what the automated system recognizes */
+State* CPSimWorld::GetCurrentState(std::vector<double> &likelihood_list, const double risk_thresh)
+{
+    likelihood_list = likelihood_;
+    for (int i = 0; i < cp_scenario_->num_targets; i++) {
+        true_state_->SetRecog(i, likelihood_[i] > risk_thresh);
+    }
+
+    *cp_state_ = *true_state_;
+    cp_state_->risk_bin = cp_state_->ego_recog;
+    return cp_state_;
+}
+
+
+const CPScenario* CPSimWorld::GetCurrentScenario() const
+{
+    return cp_scenario_;
+}
+
+
+bool CPSimWorld::ExecuteAction(ACT_TYPE action, OBS_TYPE &obs)
+{
+    return CPExecuteAction(action, obs);
+}
+
+
+/* one delta_t of the episode, same transition as CPPOMDP::Step on the true state */
+bool CPSimWorld::CPExecuteAction(ACT_TYPE &action, OBS_TYPE &obs)
+{
+    CPState prev_state = *true_state_;
+
+    /* the ego drives on the recognition before the action */
+    vehicle_model_->GetTransition(true_state_->ego_speed, true_state_->ego_pose, prev_state.ego_recog,
+                                  cp_scenario_->risk_pose.data(), cp_scenario_->sorted_idx.data(), cp_scenario_->num_targets, cp_scenario_->layout_id);
+
+    if (cp_values_->getActionAttrib(action) == CPValues::REQUEST) {
+        int target = cp_values_->getActionTarget(action);
+        if (prev_state.req_time == 0 || prev_state.req_target == target) {
+            true_state_->req_time += config_.delta_t;
+        }
+        else {
+            true_state_->req_time = config_.delta_t;
+        }
+        true_state_->req_target = target;
+
+        obs = operator_model_->ExecIntervention(true_state_->req_time, true_state_->GetRisk(target), random_.NextDouble(), CPTypeTable::GetName(cp_scenario_->risk_type[target]));
+        true_state_->SetRecog(target, obs);
+        req_target_history_.emplace_back(id_idx_list_[target]);
+    }
+    else {
+        true_state_->req_time = 0;
+        obs = CPValues::RISK;
+
+        unique_identifier_msgs::msg::UUID uuid;
+        uuid.uuid.fill(0);
+        req_target_history_.emplace_back(uuid);
+    }
+
+    step_reward_ = reward_model_->CalcReward(prev_state, *true_state_, action);
+    is_target_changed_ = false;
+    return true_state_->ego_pose >= planning_horizon_;
+}
+
+
+void CPSimWorld::UpdatePerception(const ACT_TYPE &action, const OBS_TYPE &obs, const std::vector<double> &risk_probs)
+{
+    for (size_t i = 0; i < likelihood_.size() && i < risk_probs.size(); i++) {
+        likelihood_[i] = risk_probs[i];
+    }
+}
+
+
+/* the targets of an episode do not change, only the first step starts a new belief */
+bool CPSimWorld::IsTargetChanged() const
+{
+    return is_target_changed_;
+}
+
+
+const CPSimConfig& CPSimWorld::Config() const
+{
+    return config_;
+}
+
+
+double CPSimWorld::StepReward() const
+{
+    return step_reward_;
+}
+
+
+const CPState* CPSimWorld::TrueState() const
+{
+    return true_state_;
+}
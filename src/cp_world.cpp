@@ -3,10 +3,20 @@
 CPWorld::CPWorld()
 {
     cp_state_ = new CPState();
+    cp_scenario_ = new CPScenario();
 }
 
 CPWorld::~CPWorld() {
-    rclcpp::shutdown();
+    if (state_executor_ != nullptr) {
+        state_executor_->cancel();
+    }
+    if (state_thread_.joinable()) {
+        state_thread_.join();
+    }
+    /* the context belongs to the component container */
+    if (!is_external_node_) {
+        rclcpp::shutdown();
+    }
 }
 
 
@@ -25,19 +35,94 @@ bool CPWorld::Connect(int argc, char* argv[])
 { 
     rclcpp::init(argc, argv);
     node_ = rclcpp::Node::make_shared("CPWorldNode");
-
-    intervention_client_ = node_->create_client<cooperative_perception::srv::Intervention>("/intervention");
-    current_state_client_ = node_->create_client<cooperative_perception::srv::State>("/cp_current_state");
-    update_perception_client_ = node_->create_client<cooperative_perception::srv::UpdatePerception>("/cp_updated_target");
+    if (!SetupInterfaces()) return false;
 
     rclcpp::spin_some(node_);
     return true;
 }
 
+/* run on a node which an executor outside of CPWorld spins (component container).
+ * callbacks then come from that executor, intra-process messages are not serialized.
+ */
+bool CPWorld::Connect(rclcpp::Node::SharedPtr node, rclcpp::CallbackGroup::SharedPtr callback_group, const std::atomic<bool>* stop_requested)
+{
+    node_ = node;
+    callback_group_ = callback_group;
+    stop_requested_ = stop_requested;
+    is_external_node_ = true;
+    return SetupInterfaces();
+}
+
+
+bool CPWorld::SetupInterfaces()
+{
+    use_tick_service_ = node_->declare_parameter<bool>("use_tick_service", use_tick_service_);
+    use_state_topic_ = node_->declare_parameter<bool>("use_state_topic", use_state_topic_);
+    max_state_age_ = node_->declare_parameter<double>("max_state_age", max_state_age_);
+    RCLCPP_INFO(node_->get_logger(), "[cp_world::SetupInterfaces] tick service: %d state topic: %d", use_tick_service_, use_state_topic_);
+
+    /* responses are handled by the executor of callback_group_ (default group if none) */
+    intervention_client_ = node_->create_client<cooperative_perception::srv::Intervention>("/intervention", rmw_qos_profile_services_default, callback_group_);
+    current_state_client_ = node_->create_client<cooperative_perception::srv::State>("/cp_current_state", rmw_qos_profile_services_default, callback_group_);
+    update_perception_client_ = node_->create_client<cooperative_perception::srv::UpdatePerception>("/cp_updated_target", rmw_qos_profile_services_default, callback_group_);
+
+    planner_tick_client_ = node_->create_client<cooperative_perception::srv::PlannerTick>("/cp_planner_tick", rmw_qos_profile_services_default, callback_group_);
+
+    /* streamed state is received by the container executor, or standalone on its own node and thread,
+     * so that GetCurrentState never waits for it 
+     */
+    if (use_state_topic_ && is_external_node_) {
+        rclcpp::SubscriptionOptions options;
+        options.callback_group = callback_group_;
+        sub_planner_state_ = node_->create_subscription<cooperative_perception::msg::CPPlannerState>(
+            "/cooperative_perception/planner_state", 1, std::bind(&CPWorld::PlannerStateCb, this, std::placeholders::_1), options);
+    }
+    else if (use_state_topic_) {
+        state_node_ = rclcpp::Node::make_shared("CPWorldStateNode");
+        sub_planner_state_ = state_node_->create_subscription<cooperative_perception::msg::CPPlannerState>(
+            "/cooperative_perception/planner_state", 1, std::bind(&CPWorld::PlannerStateCb, this, std::placeholders::_1));
+        state_executor_ = std::make_shared<rclcpp::executors::SingleThreadedExecutor>();
+        state_executor_->add_node(state_node_);
+        state_thread_ = std::thread([this]() { state_executor_->spin(); });
+    }
+
+    /* services are checked once here, not on every call */
+    if (use_tick_service_) {
+        return WaitForService(planner_tick_client_, "PlannerTick");
+    }
+    return WaitForService(current_state_client_, "State") 
+        && WaitForService(intervention_client_, "Intervention") 
+        && WaitForService(update_perception_client_, "UpdatePerception");
+}
+
+
+bool CPWorld::WaitForService(rclcpp::ClientBase::SharedPtr client, const std::string &name)
+{
+    while (!client->wait_for_service(1s))
+    {
+        if (!IsRunning())
+        {
+            RCLCPP_ERROR(node_->get_logger(), "[cp_world::Connect] Interrupted while waiting for service %s. Exit", name.c_str());
+            return false;
+        } 
+        RCLCPP_INFO(node_->get_logger(), "[cp_world::Connect] service %s not available", name.c_str());
+    }
+    return true;
+}
+
+
+/* context alive and no stop requested by the owner of the planning thread */
+bool CPWorld::IsRunning() const
+{
+    return rclcpp::ok() && (stop_requested_ == nullptr || !stop_requested_->load());
+}
+
 
 void CPWorld::Step() 
 {
-    rclcpp::spin_some(node_);
+    if (!is_external_node_) {
+        rclcpp::spin_some(node_);
+    }
 }
 
 State* CPWorld::GetCurrentState() {
@@ -48,55 +133,130 @@ State* CPWorld::GetCurrentState() {
 State* CPWorld::GetCurrentState(std::vector<double> &likelihood_list, const double risk_thresh) 
 {
 
-    /* request to service */
-    auto request = std::make_shared<cooperative_perception::srv::State::Request>();
-    request->request = true;
+    std::shared_ptr<cooperative_perception::srv::State::Response> buf_result;
+
+    /* latest streamed state, if it is fresh enough by its stamp */
+    const cooperative_perception::msg::CPPlannerState *streamed = nullptr;
+    if (use_state_topic_) {
+        state_snapshot_.Update();
+        if (state_snapshot_.HasValue()) {
+            double age = StampAge(state_snapshot_.Front().header.stamp);
+            if (age <= max_state_age_) {
+                streamed = &state_snapshot_.Front();
+            }
+            else {
+                RCLCPP_INFO(node_->get_logger(), "[cp_world::GetCurrentState] streamed state is outdated, age: %f", age);
+            }
+        }
+    }
 
-    while (!current_state_client_->wait_for_service(1s))
-    {
-        if (!rclcpp::ok())
-        {
-            RCLCPP_ERROR(node_->get_logger(), "[cp_world::GetCurrentState] Interrupted while waiting for service. Exit");
-            return nullptr;
-        } 
-        RCLCPP_INFO(node_->get_logger(), "[cp_world::GetCurrentState] service not available");
+    /* state comes with the PlannerTick of the last step (first step: tick without action, unless streamed) */
+    if (use_tick_service_ && tick_result_ == nullptr && streamed == nullptr) {
+        unique_identifier_msgs::msg::UUID uuid;
+        if (!SendTick(false, CPValues::NO_ACTION, uuid)) return nullptr;
     }
 
-    auto result = current_state_client_->async_send_request(request);
-    if (rclcpp::spin_until_future_complete(node_, result) != rclcpp::FutureReturnCode::SUCCESS)
-    {
-        RCLCPP_ERROR(node_->get_logger(), "[cp_world::GetCurrentState] failed to call service Intervention");
+    /* the newer of both: more likelihood updates of CPRosInterface contained, then the later stamp.
+     * a streamed state published before the tick must not undo the likelihoods the tick has sent
+     */
+    bool use_tick = tick_result_ != nullptr;
+    if (use_tick && streamed != nullptr) {
+        use_tick = tick_result_->applied_seq > streamed->applied_seq
+            || (tick_result_->applied_seq == streamed->applied_seq && StampAge(tick_result_->header.stamp) <= StampAge(streamed->header.stamp));
+    }
+
+    if (use_tick) {
+        buf_result = std::make_shared<cooperative_perception::srv::State::Response>();
+        buf_result->header = tick_result_->header;
+        buf_result->applied_seq = tick_result_->applied_seq;
+        buf_result->object_id = std::move(tick_result_->object_id);
+        buf_result->ego_speed = tick_result_->ego_speed;
+        buf_result->risk_pose = std::move(tick_result_->risk_pose);
+        buf_result->likelihood = std::move(tick_result_->likelihood);
+        buf_result->type = std::move(tick_result_->type);
+        state_age_ = StampAge(buf_result->header.stamp);
+    }
+    else if (streamed != nullptr) {
+        buf_result = std::make_shared<cooperative_perception::srv::State::Response>();
+        buf_result->header = streamed->header;
+        buf_result->applied_seq = streamed->applied_seq;
+        buf_result->object_id = streamed->object_id;
+        buf_result->ego_speed = streamed->ego_speed;
+        buf_result->risk_pose = streamed->risk_pose;
+        buf_result->likelihood = streamed->likelihood;
+        buf_result->type = streamed->type;
+        state_age_ = StampAge(buf_result->header.stamp);
+    }
+    tick_result_ = nullptr;
+
+    if (buf_result == nullptr && use_tick_service_) {
+        RCLCPP_ERROR(node_->get_logger(), "[cp_world::GetCurrentState] no state from PlannerTick");
         return nullptr;
     }
+    else if (buf_result == nullptr) {
+        /* the prefetched state is too old -> ask again */
+        if (is_state_requested_ && get_time_second() - state_request_t_ > max_state_age_) {
+            current_state_client_->remove_pending_request(state_future_);
+            is_state_requested_ = false;
+            RCLCPP_INFO(node_->get_logger(), "[cp_world::GetCurrentState] drop outdated state request");
+        }
+        SendStateRequest();
+
+        if (!WaitForFuture(state_future_))
+        {
+            RCLCPP_ERROR(node_->get_logger(), "[cp_world::GetCurrentState] failed to call service State");
+            is_state_requested_ = false;
+            return nullptr;
+        }
+        is_state_requested_ = false;
+        buf_result = state_future_.get();
+        state_age_ = StampAge(buf_result->header.stamp);
+    }
+    RCLCPP_INFO(node_->get_logger(), "[GetCurrentState] update cp_state_, id_idx_list_, likelihood_list, state age: %f", state_age_);
 
-    RCLCPP_INFO(node_->get_logger(), "[GetCurrentState] update cp_state_, id_idx_list_, likelihood_list ");
     /* start making current state*/
     // check wether last request target still exists in the perception targets
     bool is_last_req_target_exist = false;
 
-    std::shared_ptr<cooperative_perception::srv::State::Response> buf_result = result.get();
-    cp_state_->risk_pose.clear();
-    cp_state_->ego_recog.clear();
-    cp_state_->risk_bin.clear();
-    cp_state_->risk_type.clear();
+    cp_state_->ClearTargets();
+    cp_scenario_->Clear();
     cp_state_->ego_pose = 0;
     cp_state_->ego_speed = buf_result->ego_speed;
 
+    std::swap(prev_idx_table_, idx_table_);
     id_idx_list_.clear();
+    idx_table_.Clear();
+    prev_idx_list_.clear();
+    is_target_changed_ = (size_t(prev_idx_table_.Size()) != std::min<size_t>(buf_result->object_id.size(), CP_MAX_TARGETS));
 
-
-
+    std::lock_guard<std::mutex> lock(pushed_mutex_);
+    ConfirmPushed(buf_result->applied_seq);
     for (auto it = buf_result->object_id.begin(), end = buf_result->object_id.end(); it != end; ++it) 
     {
         int i = std::distance(buf_result->object_id.begin(), it);
+        if (i >= CP_MAX_TARGETS) {
+            RCLCPP_WARN(node_->get_logger(), "[GetCurrentState] too many targets, ignore the rest");
+            break;
+        }
+        CPUuid uuid(it->uuid);
         id_idx_list_[i] = *it;
+        idx_table_[uuid] = i;
         double &likelihood = buf_result->likelihood[i];
+        const PushedLikelihood *pushed = pushed_likelihood_.Get(uuid);
+        if (pushed != nullptr) {
+            likelihood = pushed->likelihood;
+        }
         likelihood_list.emplace_back(likelihood);
 
-        cp_state_->ego_recog.emplace_back(likelihood>risk_thresh);
-        cp_state_->risk_bin.emplace_back(likelihood>risk_thresh);
-        cp_state_->risk_pose.emplace_back(buf_result->risk_pose[i]);
-        cp_state_->risk_type.emplace_back(buf_result->type[i].data);
+        cp_scenario_->AddTarget(buf_result->risk_pose[i], CPTypeTable::GetId(buf_result->type[i].data));
+        cp_state_->SetRecog(i, likelihood>risk_thresh);
+        cp_state_->SetRisk(i, likelihood>risk_thresh);
+
+        /* index of this target at the last step */
+        const int *prev_idx_ptr = prev_idx_table_.Get(uuid);
+        int prev_idx = (prev_idx_ptr != nullptr) ? *prev_idx_ptr : -1;
+        prev_idx_list_.emplace_back(prev_idx);
+        if (prev_idx != i) is_target_changed_ = true;
 
         /* is this request target (index can change at each time step) */
         if (req_target_history_.size() > 0 && req_target_history_.back().uuid == buf_result->object_id[i].uuid) {
@@ -107,11 +267,21 @@ State* CPWorld::GetCurrentState(std::vector<double> &likelihood_list, const doub
         std::stringstream ss;
         ss << "[GetCurrentState]" << "\n"
            << "id   :" << i << "\n" 
-           << "pose :" << cp_state_->risk_pose[i] << "\n" 
+           << "pose :" << cp_scenario_->risk_pose[i] << "\n" 
            << "prob :" << likelihood << "\n";
         RCLCPP_INFO(node_->get_logger(), ss.str().c_str());
     }
 
+    /* pushed likelihood of targets which are gone is no longer needed */
+    for (int i = 0; i < pushed_likelihood_.Size();) {
+        if (idx_table_.Find(pushed_likelihood_.KeyAt(i)) < 0) {
+            pushed_likelihood_.EraseAt(i);
+        }
+        else {
+            ++i;
+        }
+    }
+
 
     // check last request and update request time
     if (!is_last_req_target_exist) 
@@ -123,13 +293,72 @@ State* CPWorld::GetCurrentState(std::vector<double> &likelihood_list, const doub
         RCLCPP_INFO(node_->get_logger(), "[GetCurrentState] continue request");
     }
 
-    cp_values_ = new CPValues(cp_state_->risk_pose.size());
+    cp_values_ = new CPValues(cp_scenario_->num_targets);
     // state = dynamic_cast<CPState>(*cp_state_);
-    std::cout << cp_state_->risk_pose.size() << std::endl;
+    std::cout << cp_scenario_->num_targets << std::endl;
     return cp_state_;
 }
 
 
+/* send the state request without waiting for the response.
+ * called before the search so that the service round trip overlaps with planning.
+ */
+void CPWorld::RequestState()
+{
+    /* state is streamed, or PlannerTick returns it together with the intervention result */
+    if (use_state_topic_ || use_tick_service_) return;
+    SendStateRequest();
+}
+
+
+void CPWorld::SendStateRequest()
+{
+    if (is_state_requested_) return;
+
+    auto request = std::make_shared<cooperative_perception::srv::State::Request>();
+    request->request = true;
+    state_future_ = current_state_client_->async_send_request(request).share();
+    state_request_t_ = get_time_second();
+    is_state_requested_ = true;
+}
+
+
+/* pushed likelihoods which a state with applied_seq contains are no longer needed (pushed_mutex_ held) */
+void CPWorld::ConfirmPushed(const uint64_t applied_seq)
+{
+    for (int i = 0; i < pushed_likelihood_.Size();) {
+        const PushedLikelihood &pushed = pushed_likelihood_.ValueAt(i);
+        if (pushed.is_acked && pushed.applied_seq <= applied_seq) {
+            pushed_likelihood_.EraseAt(i);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+
+/* [s] since the stamp of a state, on the clock of node_ (ros time, like the stamps of CPRosInterface) */
+double CPWorld::StampAge(const builtin_interfaces::msg::Time &stamp) const
+{
+    return (node_->now() - rclcpp::Time(stamp, node_->get_clock()->get_clock_type())).seconds();
+}
+
+
+/* runs on the state thread (or the container executor): only the back buffer of the snapshot is touched */
+void CPWorld::PlannerStateCb(cooperative_perception::msg::CPPlannerState::UniquePtr msg)
+{
+    state_snapshot_.Back() = std::move(*msg);
+    state_snapshot_.Publish();
+}
+
+
+const CPScenario* CPWorld::GetCurrentScenario() const
+{
+    return cp_scenario_;
+}
+
+
 bool CPWorld::ExecuteAction(ACT_TYPE action, OBS_TYPE& obs) {
     return false;
 }
@@ -155,7 +384,7 @@ bool CPWorld::CPExecuteAction(ACT_TYPE &action, OBS_TYPE& obs) {
             cp_state_->req_time += Globals::config.time_per_move;
         }
         else {
-            cp_state_->ego_recog[req_target_idx] = CPValues::RISK;
+            cp_state_->SetRecog(req_target_idx, CPValues::RISK);
             cp_state_->req_time = Globals::config.time_per_move;
             cp_state_->req_target = req_target_idx;
         }
@@ -179,47 +408,40 @@ bool CPWorld::CPExecuteAction(ACT_TYPE &action, OBS_TYPE& obs) {
         request->object_id = uuid;
     }
 
-    /* throw request */
-    while (!intervention_client_->wait_for_service(1s))
-    {
-        if (!rclcpp::ok())
+    /* send request */
+    unique_identifier_msgs::msg::UUID result_id;
+    uint8_t result;
+    if (use_tick_service_) {
+        if (!SendTick(true, request->action, request->object_id)) return false;
+        result_id = tick_result_->result_object_id;
+        result = tick_result_->result;
+    }
+    else {
+        auto future = intervention_client_->async_send_request(request);
+        if (!WaitForFuture(future))
         {
-            RCLCPP_ERROR(node_->get_logger(), "[CPExecuteAction] Interrupted while waiting for service. Exit");
+            RCLCPP_ERROR(node_->get_logger(), "[CPExecuteAction] failed to call service Intervention");
             return false;
-        } 
-        RCLCPP_INFO(node_->get_logger(), "[CPExecuteAction] service not available");
-    }
-
-    /* send request */
-    auto result = intervention_client_->async_send_request(request);
-    if (rclcpp::spin_until_future_complete(node_, result) != rclcpp::FutureReturnCode::SUCCESS)
-    {
-        RCLCPP_ERROR(node_->get_logger(), "[CPExecuteAction] failed to call service Intervention");
-        return false;
+        }
+        std::shared_ptr<cooperative_perception::srv::Intervention::Response> result_get = future.get();
+        result_id = result_get->object_id;
+        result = result_get->result;
     }
 
     /* process request result (observation) */
-    std::shared_ptr<cooperative_perception::srv::Intervention::Response> result_get = result.get();
-    auto intervention_target_id = CPRosTools().ConvertUUIDtoIntString(result_get->object_id.uuid);
-
     /* action of the obs can be different
      * because of time delay of operator intervention
      */
     bool is_intervention_target_found = false;
-    for (const auto &itr : id_idx_list_) {
-        std::cout 
-            << CPRosTools().ConvertUUIDtoIntString(itr.second.uuid) << "\n" 
-            << intervention_target_id << std::endl;
-        if (CPRosTools().ConvertUUIDtoIntString(itr.second.uuid) == intervention_target_id) {
-            /* intervention result is the result of action at last time step */
-            action = cp_values_->getAction(CPValues::REQUEST, itr.first);
-            obs = result_get->result;
-            is_intervention_target_found = true;
-            RCLCPP_INFO(node_->get_logger(), "[CPExecuteAction] intervention target found");
-            cp_values_->printObs(obs);
-            std::cout << cp_values_->getActionTarget(action) << std::endl;
-            break;
-        }
+    const int *intervention_target_idx = idx_table_.Get(CPUuid(result_id.uuid));
+    if (intervention_target_idx != nullptr) {
+        /* intervention result is the result of action at last time step */
+        action = cp_values_->getAction(CPValues::REQUEST, *intervention_target_idx);
+        obs = result;
+        is_intervention_target_found = true;
+        RCLCPP_INFO(node_->get_logger(), "[CPExecuteAction] intervention target found");
+        cp_values_->printObs(obs);
+        std::cout << cp_values_->getActionTarget(action) << std::endl;
     }
 
     if (!is_intervention_target_found) {
@@ -233,8 +455,26 @@ bool CPWorld::CPExecuteAction(ACT_TYPE &action, OBS_TYPE& obs) {
 }
 
 
+bool CPWorld::IsTargetChanged () const
+{
+    return is_target_changed_;
+}
+
+
 void CPWorld::UpdatePerception (const ACT_TYPE &action, const OBS_TYPE &obs, const std::vector<double> &risk_probs)
 {
+    /* posterior of all targets goes out with the next PlannerTick, 
+     * until then it overrides the state returned by the last one 
+     */
+    if (use_tick_service_) {
+        std::lock_guard<std::mutex> lock(pushed_mutex_);
+        for (const auto &itr : id_idx_list_) {
+            if (itr.first >= static_cast<int>(risk_probs.size())) continue;
+            pushed_likelihood_[CPUuid(itr.second.uuid)] = {risk_probs[itr.first], update_seq_++, false, 0};
+        }
+        return;
+    }
+
     if (cp_values_->getActionAttrib(action) == CPValues::NO_ACTION) {
         RCLCPP_INFO(node_->get_logger(), "[UpdatePerception] NO_ACTION");
         return;
@@ -246,23 +486,69 @@ void CPWorld::UpdatePerception (const ACT_TYPE &action, const OBS_TYPE &obs, con
     request->object_id = id_idx_list_[target_index];
     request->likelihood = risk_probs[target_index];
 
-    /* throw request */
-    while (!update_perception_client_->wait_for_service(1s)) {
-        if (!rclcpp::ok()) {
-            RCLCPP_ERROR(node_->get_logger(), "[UpdatePerception] Interrupted while waiting for service. Exit");
-            return;
-        } 
-
-        RCLCPP_INFO(node_->get_logger(), "[UpdatePerception] service not available");
+    /* keep it until the service has answered, a state requested before may not contain it */
+    int seq = update_seq_++;
+    {
+        std::lock_guard<std::mutex> lock(pushed_mutex_);
+        pushed_likelihood_[CPUuid(request->object_id.uuid)] = {request->likelihood, seq, false, 0};
     }
 
-    /* get request */
-    auto result = update_perception_client_->async_send_request(request);
+    /* throw request without waiting for the response */
+    CPUuid uuid(request->object_id.uuid);
+    update_perception_client_->async_send_request(request, 
+        [this, uuid, seq](rclcpp::Client<cooperative_perception::srv::UpdatePerception>::SharedFuture future) {
+            std::lock_guard<std::mutex> lock(pushed_mutex_);
+            PushedLikelihood *pushed = pushed_likelihood_.Get(uuid);
+            if (pushed != nullptr && pushed->seq == seq) {
+                pushed->is_acked = true;
+                pushed->applied_seq = future.get()->applied_seq;
+            }
+            if (!future.get()->result) {
+                RCLCPP_INFO(node_->get_logger(), "[UpdatePerception] target no longer exists");
+            }
+        });
+}
 
-    if (rclcpp::spin_until_future_complete(node_, result) != rclcpp::FutureReturnCode::SUCCESS) {
-        RCLCPP_ERROR (node_->get_logger(), "[UpdatePerception] failed to call service Intervention");
-        return;
+
+/* one round trip per step: pushed likelihoods not sent yet, intervention of the action (if any)
+ * and the state for the next step. the result is kept in tick_result_.
+ * sent likelihoods stay pushed until a state confirms them (see ConfirmPushed).
+ */
+bool CPWorld::SendTick(const bool has_action, const uint8_t action, const unique_identifier_msgs::msg::UUID &object_id)
+{
+    auto request = std::make_shared<cooperative_perception::srv::PlannerTick::Request>();
+    request->has_action = has_action;
+    request->action = action;
+    request->object_id = object_id;
+    std::vector<std::pair<CPUuid, int>> sent;
+    std::unique_lock<std::mutex> lock(pushed_mutex_);
+    for (int i = 0; i < pushed_likelihood_.Size(); ++i) {
+        const PushedLikelihood &pushed = pushed_likelihood_.ValueAt(i);
+        if (pushed.is_acked) continue;
+        unique_identifier_msgs::msg::UUID uuid;
+        uuid.uuid = pushed_likelihood_.KeyAt(i).ToArray();
+        request->update_object_id.emplace_back(uuid);
+        request->update_likelihood.emplace_back(pushed.likelihood);
+        sent.emplace_back(pushed_likelihood_.KeyAt(i), pushed.seq);
     }
-}
+    lock.unlock();
 
+    auto result = planner_tick_client_->async_send_request(request);
+    if (!WaitForFuture(result))
+    {
+        RCLCPP_ERROR(node_->get_logger(), "[cp_world::SendTick] failed to call service PlannerTick");
+        return false;
+    }
 
+    /* applied before the returned state was made */
+    lock.lock();
+    tick_result_ = result.get();
+    for (const auto &itr : sent) {
+        PushedLikelihood *pushed = pushed_likelihood_.Get(itr.first);
+        if (pushed != nullptr && pushed->seq == itr.second) {
+            pushed->is_acked = true;
+            pushed->applied_seq = tick_result_->applied_seq;
+        }
+    }
+    return true;
+}
@@ -10,7 +10,7 @@ despot::ValuedAction MyopicModel::Search()
     /* keep request */
     if (0 < cp_state_->req_time
         && cp_state_->req_time < request_time_ 
-        && cp_state_->risk_pose[cp_state_->req_target] > decel_dist) {
+        && cp_scenario_->risk_pose[cp_state_->req_target] > decel_dist) {
 
         va.action = cp_values_->getAction(CPValues::REQUEST, cp_state_->req_target);
         return va;
@@ -18,7 +18,7 @@ despot::ValuedAction MyopicModel::Search()
 
     /* find request target */
     int closest_target = -1, min_dist = 100000;
-    for (int i=0; i<cp_state_->risk_pose.size(); i++) {
+    for (int i=0; i<cp_scenario_->num_targets; i++) {
 
         int is_in_history = std::count(req_target_history_.begin(), 
                                        req_target_history_.end(), 
@@ -33,10 +33,10 @@ despot::ValuedAction MyopicModel::Search()
             * (request_time_ - vehicle_model_->GetDecelTime(cp_state_->ego_speed,
                                                             vehicle_model_->min_decel_));
         /* target which never requested and enough distance */
-        if (is_in_history == 0 && cp_state_->risk_pose[i] > request_distance) {
-            if (cp_state_->risk_pose[i] < min_dist) {
+        if (is_in_history == 0 && cp_scenario_->risk_pose[i] > request_distance) {
+            if (cp_scenario_->risk_pose[i] < min_dist) {
 
-               min_dist = cp_state_->risk_pose[i];
+               min_dist = cp_scenario_->risk_pose[i];
                closest_target = i;
             }
         }
@@ -2,29 +2,59 @@
 #include "cooperative_perception/operator_model.hpp"
 
 OperatorModel::OperatorModel() {
+    CompileAccuracyTable(max_time_);
 }
 
 OperatorModel::OperatorModel(const std::map<std::string, PerceptionPerformance> &performance) :
     performance_(performance) {
+    CompileAccuracyTable(max_time_);
 }
 
 OperatorModel::~OperatorModel(){
 }
 
-double OperatorModel::InterventionAccuracy(const int time, const std::string type) const {
+/* register every type of performance_ to CPTypeTable and tabulate the accuracy at time = 0 .. max_time */
+void OperatorModel::CompileAccuracyTable(const int max_time) {
+    for (const auto &performance : performance_) {
+        despot::CPTypeTable::GetId(performance.first);
+    }
+
+    max_time_ = max_time;
+    num_types_ = despot::CPTypeTable::Size();
+    acc_table_.assign(num_types_ * (max_time_ + 1), 0.5);
+    for (int id = 0; id < num_types_; id++) {
+        const std::string &type = despot::CPTypeTable::GetName(id);
+        if (performance_.count(type) == 0) continue;
+        for (int t = 0; t <= max_time_; t++) {
+            acc_table_[id * (max_time_ + 1) + t] = InterventionAccuracy(t, type);
+        }
+    }
+}
+
+double OperatorModel::InterventionAccuracy(const int time, const int type_id) const {
+
+    /* type or time not compiled -> look up performance_ (throws for unknown types as before) */
+    if (type_id < 0 || type_id >= num_types_ || time < 0 || time > max_time_) {
+        return InterventionAccuracy(time, despot::CPTypeTable::GetName(type_id));
+    }
+    return acc_table_[type_id * (max_time_ + 1) + time];
+}
 
-    if (time < performance_.at(type).ope_min_time) {
+double OperatorModel::InterventionAccuracy(const int time, const std::string &type) const {
+
+    const PerceptionPerformance &performance = performance_.at(type);
+    if (time < performance.ope_min_time) {
         return 0.5;
     }
     else {
-        double acc = performance_.at(type).ope_min_acc + performance_.at(type).ope_slope_acc_time * (time - performance_.at(type).ope_min_time);
+        double acc = performance.ope_min_acc + performance.ope_slope_acc_time * (time - performance.ope_min_time);
         // std::cout << "acc :" << acc << ", time : " << time << std::endl;
-        acc = (acc < performance_.at(type).ope_max_acc) ? acc : performance_.at(type).ope_max_acc;
+        acc = (acc < performance.ope_max_acc) ? acc : performance.ope_max_acc;
         return acc;
     }
 }
 
-int OperatorModel::ExecIntervention(const int time, const bool risk, const std::string type) const {
+int OperatorModel::ExecIntervention(const int time, const bool risk, const std::string &type) const {
 
     if (time == 0) {
         return CPValues::RISK;
@@ -44,14 +74,21 @@ int OperatorModel::ExecIntervention(const int time, const bool risk, const std::
     }
 }
 
-int OperatorModel::ExecIntervention(const int time, const bool risk, const double rand_num, const std::string type) const {
+int OperatorModel::ExecIntervention(const int time, const bool risk, const double rand_num, const std::string &type) const {
+
+    if (time == 0) {
+        return CPValues::RISK;
+    }
+    return ExecIntervention(time, risk, rand_num, InterventionAccuracy(time, type));
+}
+
+/* same as above with the accuracy already looked up (e.g. from CPScenario) */
+int OperatorModel::ExecIntervention(const int time, const bool risk, const double rand_num, const double acc) const {
 
     if (time == 0) {
         return CPValues::RISK;
     }
     else {
-        double acc = InterventionAccuracy(time, type);
-    
         // TODO: is this output is okay? especially "else" section
         if (rand_num <= acc) {
             return (risk == CPValues::RISK) ? CPValues::RISK : CPValues::NO_RISK;    
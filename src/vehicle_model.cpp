@@ -10,18 +10,20 @@ VehicleModel::VehicleModel() :
         delta_t_(1.0) {
         }
 
+/* default vehicle with another time step */
 VehicleModel::VehicleModel(const double delta_t):
-        delta_t_(delta_t) {
+        VehicleModel() {
+        delta_t_ = delta_t;
         }
 
 VehicleModel::VehicleModel(double max_speed, double yield_speed, double max_accel, double max_decel, double min_decel, double safety_margin, double delta_t) :
-        max_speed_(max_speed_),
-        yield_speed_(yield_speed_),
-        max_accel_(max_accel_),
-        max_decel_(max_decel_),
-        min_decel_(min_decel_),
-        safety_margin_(safety_margin_),
-        delta_t_(delta_t_) {
+        max_speed_(max_speed),
+        yield_speed_(yield_speed),
+        max_accel_(max_accel),
+        max_decel_(max_decel),
+        min_decel_(min_decel),
+        safety_margin_(safety_margin),
+        delta_t_(delta_t) {
         }
 
 
@@ -35,52 +37,41 @@ double VehicleModel::GetDecelTime(const double speed, const double acc) const {
     return speed / decel;
 }
 
-double VehicleModel::GetAccel(const double speed, const int pose, const std::vector<bool>& recog_list, const std::vector<int>& target_poses) const {
+/* acceleration to yield to the recognized targets ahead.
+ * sorted_idx is the target index in ascending order of target_poses,
+ * so only the targets between the ego pose and the braking envelope are visited.
+ */
+double VehicleModel::GetAccel(const double speed, const int pose, const uint64_t recog_mask, const int* target_poses, const int* sorted_idx, const int num_targets) const {
+
+    // speed only terms
+    double emergency_decel_dist = GetDecelDistance(speed, max_decel_, 0.0);
+    double comf_decel_dist = GetDecelDistance(speed, min_decel_, safety_margin_);
+    double window_dist = comf_decel_dist + 10;
+    double speed_diff_sq = yield_speed_ * yield_speed_ - speed * speed;
 
-    // if (speed <= yield_speed_) return 0.0;
+    double min_acc = (speed < max_speed_ || speed < yield_speed_) ? max_accel_ : 1000.0;
 
-    std::vector<double> acc_list;
-	for (auto itr=recog_list.begin(), end=recog_list.end(); itr!=end; itr++) {
-        int distance = target_poses[std::distance(recog_list.begin(), itr)] - pose;
-        double emergency_decel_dist = GetDecelDistance(speed, max_decel_, 0.0);
-        double comf_decel_dist = GetDecelDistance(speed, min_decel_, safety_margin_);
+    // first target at or ahead of the ego pose
+    const int* itr = std::lower_bound(sorted_idx, sorted_idx + num_targets, pose, 
+            [target_poses](const int idx, const int p) { return target_poses[idx] < p; });
 
-        // std::cout << pose << " decel_dist" << emergency_decel_dist << " comf_decel" << comf_decel_dist  << " distance: " << distance << std::endl;
-        // if (distance < 0 || *itr == false) continue;
-        // if (distance < 0 || emergency_decel_dist > distance || *itr == false) continue;
-        if (distance < 0 || comf_decel_dist + 10 < distance || *itr == false) continue;
+    for (const int* end = sorted_idx + num_targets; itr != end; ++itr) {
+        int distance = target_poses[*itr] - pose;
+        if (window_dist < distance) break;
+        if (((recog_mask >> *itr) & 1ULL) == 0) continue;
+
+        double a;
         if (distance > comf_decel_dist) {
-            double a = (std::pow(yield_speed_, 2.0) - std::pow(speed, 2.0))/(2.0*(distance+safety_margin_));
-            acc_list.emplace_back(a);
+            a = speed_diff_sq / (2.0*(distance+safety_margin_));
         }
         else if (distance > emergency_decel_dist) {
-            double a = (std::pow(yield_speed_, 2.0) - std::pow(speed, 2.0))/(2.0*(distance));
-            acc_list.emplace_back(a);
+            a = speed_diff_sq / (2.0*distance);
         }
         else {
-            acc_list.emplace_back(-max_decel_);
-        }
-
-        // std::cout << pose << " decel_dist" << emergency_decel_dist << " comf_decel" << comf_decel_dist  << " distance: " << distance << ", accel : " << a << std::endl;
-        // if (-min_decel_ < a && a < 0.0) continue;
-
-    }
-
-    if (speed < max_speed_ || speed < yield_speed_) 
-        acc_list.emplace_back(max_accel_);
-
-    double min_acc = 1000.0;
-    for (const auto itr : acc_list) {
-        if (itr < min_acc) {
-            min_acc = itr;
+            a = -max_decel_;
         }
+        min_acc = (a < min_acc) ? a : min_acc;
     }
-    // auto a_itr = std::min_element(acc_list.begin(), acc_list.end());
-    // double min_acc = *a_itr;
-    // std::cout << "min_acc : " << min_acc << std::endl;
-    // int decel_target = target.distanceance(acc_list.begin(), a_itr);
-    // std::cout << "pose: " << pose << " speed: " << speed << " acc: " << min_acc << std::endl;
-    
 
     return min_acc;
 }
@@ -111,11 +102,35 @@ double VehicleModel::ClipSpeed(const double acc, const double v0) const{
     return clipped_acc;
 }
 
-void VehicleModel::GetTransition(double& speed, int& pose, const std::vector<bool>& recog_list, const std::vector<int>& target_poses) const {
+void VehicleModel::GetTransition(double& speed, int& pose, const uint64_t recog_mask, const int* target_poses, const int* sorted_idx, const int num_targets, const uint64_t layout_id) const {
+
+    /* the cache is only valid for the target layout given to ResetTransitionCache (0: no layout) */
+    int worker_id = CPWorker::Id();
+    bool use_cache = use_transition_cache_ 
+        && layout_id != 0
+        && layout_id == cache_layout_id_
+        && worker_id < static_cast<int>(transition_caches_.size());
+
+    TransitionKey key;
+    TransitionCache* cache = nullptr;
+    if (use_cache) {
+        cache = &transition_caches_[worker_id];
+        key = {std::lround(speed / cache_speed_res_), pose, recog_mask};
+        auto itr = cache->table.find(key);
+        if (itr != cache->table.end()) {
+            cache->hit++;
+            speed = itr->second.speed;
+            pose = itr->second.pose;
+            return;
+        }
+        cache->miss++;
+        // transit from the quantized speed so that the cached value does not depend on the first caller
+        speed = key.speed * cache_speed_res_;
+    }
 
     for (int i = 0; i < delta_t_; i++) {
         double v0 = speed;
-        double a = GetAccel(speed, pose, recog_list, target_poses);
+        double a = GetAccel(speed, pose, recog_mask, target_poses, sorted_idx, num_targets);
         double clipped_a = ClipSpeed(a, v0);
 
         // speed = v0 + clipped_a * delta_t_;
@@ -124,5 +139,45 @@ void VehicleModel::GetTransition(double& speed, int& pose, const std::vector<boo
         pose += v0 + 0.5 * clipped_a;
     }
 
+    if (use_cache) {
+        if (cache->table.size() >= max_cache_size_) {
+            cache->table.clear();
+        }
+        cache->table.emplace(key, TransitionValue{speed, pose});
+    }
+
     return;
 }
+
+/* bind the cache to the target layout of the current step and drop old entries */
+void VehicleModel::ResetTransitionCache(const uint64_t layout_id) {
+    for (auto& cache : transition_caches_) {
+        cache.table.clear();
+        cache.hit = 0;
+        cache.miss = 0;
+    }
+    cache_layout_id_ = layout_id;
+}
+
+/* must not be called while a search is running */
+void VehicleModel::SetNumWorkers(const int num_workers) {
+    if (num_workers > static_cast<int>(transition_caches_.size())) {
+        transition_caches_.resize(num_workers);
+    }
+}
+
+void VehicleModel::PrintCacheStats(std::ostream& out) const {
+    uint64_t hit = 0, miss = 0;
+    size_t size = 0;
+    for (const auto& cache : transition_caches_) {
+        hit += cache.hit;
+        miss += cache.miss;
+        size += cache.table.size();
+    }
+    uint64_t total = hit + miss;
+    out << "[vehicle_model] transition cache hit: " << hit 
+        << " miss: " << miss
+        << " hit rate: " << ((total > 0) ? static_cast<double>(hit) / total : 0.0)
+        << " size: " << size 
+        << " workers: " << transition_caches_.size() << std::endl;
+}
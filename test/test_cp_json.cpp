@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include "cooperative_perception/cp_json.hpp"
+
+
+TEST(CPJson, ParseValues)
+{
+    CPJson json;
+    std::string error;
+    ASSERT_TRUE(CPJson::Parse(R"({"a": 1.5, "b": [true, false, null], "c": "x\"y", "d": {}, "e": -2e3})", json, error)) << error;
+    ASSERT_EQ(json.type, CPJson::OBJECT);
+    ASSERT_EQ(json.object.size(), 5u);
+    EXPECT_EQ(json.object[0].first, "a"); // order of the text
+
+    EXPECT_DOUBLE_EQ(json.Get("a")->number, 1.5);
+    const CPJson *b = json.Get("b");
+    ASSERT_EQ(b->type, CPJson::ARRAY);
+    ASSERT_EQ(b->array.size(), 3u);
+    EXPECT_TRUE(b->array[0].boolean);
+    EXPECT_EQ(b->array[1].type, CPJson::BOOL);
+    EXPECT_FALSE(b->array[1].boolean);
+    EXPECT_EQ(b->array[2].type, CPJson::NUL);
+    EXPECT_EQ(json.Get("c")->string, "x\"y");
+    EXPECT_EQ(json.Get("d")->type, CPJson::OBJECT);
+    EXPECT_TRUE(json.Get("d")->object.empty());
+    EXPECT_DOUBLE_EQ(json.Get("e")->number, -2000.0);
+    EXPECT_EQ(json.Get("f"), nullptr);
+}
+
+
+TEST(CPJson, TrailingComma)
+{
+    CPJson json;
+    std::string error;
+    ASSERT_TRUE(CPJson::Parse("{\n  \"risk_pose\": [50, 80,],\n}\n", json, error)) << error;
+    ASSERT_EQ(json.Get("risk_pose")->array.size(), 2u);
+    EXPECT_DOUBLE_EQ(json.Get("risk_pose")->array[1].number, 80.0);
+}
+
+
+TEST(CPJson, Errors)
+{
+    CPJson json;
+    std::string error;
+    EXPECT_FALSE(CPJson::Parse("", json, error));
+    EXPECT_FALSE(CPJson::Parse("{\"a\" 1}", json, error));
+    EXPECT_FALSE(CPJson::Parse("[1 2]", json, error));
+    EXPECT_FALSE(CPJson::Parse("\"open", json, error));
+    EXPECT_FALSE(CPJson::Parse("tru", json, error));
+    EXPECT_FALSE(CPJson::Parse("{} x", json, error));
+    EXPECT_FALSE(CPJson::Parse("{a: 1}", json, error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(CPJson::Load("/nonexistent/param.json", json, error));
+}
+
+
+TEST(CPJson, QuoteRoundTrip)
+{
+    const std::string value = "line\n\"quoted\" back\\slash";
+    CPJson json;
+    std::string error;
+    ASSERT_TRUE(CPJson::Parse(CPJson::Quote(value), json, error)) << error;
+    EXPECT_EQ(json.type, CPJson::STRING);
+    EXPECT_EQ(json.string, value);
+}
+
+
+/* the scenario configs read by CPSimConfig::Load, with the trailing commas they are written with */
+TEST(CPJson, LoadConfigs)
+{
+    for (int i = 1; i <= 4; i++) {
+        const std::string path = std::string(CP_CONFIG_DIR) + "/param_" + std::to_string(i) + ".json";
+        CPJson json;
+        std::string error;
+        ASSERT_TRUE(CPJson::Load(path, json, error)) << path << ": " << error;
+
+        const CPJson *likelihood = json.Get("risk_likelihood");
+        const CPJson *pose = json.Get("risk_pose");
+        ASSERT_NE(likelihood, nullptr) << path;
+        ASSERT_NE(pose, nullptr) << path;
+        EXPECT_EQ(likelihood->array.size(), pose->array.size()) << path;
+        EXPECT_FALSE(pose->array.empty()) << path;
+        ASSERT_NE(json.Get("delta_t"), nullptr) << path;
+        EXPECT_GT(json.Get("delta_t")->number, 0.0) << path;
+    }
+}
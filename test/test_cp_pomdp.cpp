@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+
+#include "despot/interface/default_policy.h"
+#include "cooperative_perception/cp_pomdp.hpp"
+
+using namespace despot;
+
+
+class CPPOMDPTest: public ::testing::Test {
+protected:
+    std::mt19937 random_{7};
+    VehicleModel* vehicle_model_ = nullptr;
+    OperatorModel* operator_model_ = nullptr;
+
+protected:
+    void SetUp() override {
+        vehicle_model_ = new VehicleModel();
+        operator_model_ = new OperatorModel();
+    }
+
+    void TearDown() override {
+        delete operator_model_;
+        delete vehicle_model_;
+    }
+
+    double NextDouble() {
+        return std::uniform_real_distribution<double>(0.0, 1.0)(random_);
+    }
+
+    CPScenario RandomScenario(const int max_targets) {
+        CPScenario scenario;
+        int num_targets = 1 + random_() % max_targets;
+        for (int i = 0; i < num_targets; i++) {
+            scenario.AddTarget(10 + random_() % 140, CPTypeTable::GetId((random_() % 2) ? "hard" : "easy"));
+        }
+        return scenario;
+    }
+};
+
+
+/* StepBatch on a structure-of-arrays particle set gives the same states, rewards, observations
+ * and terminal flags as Step on every particle
+ */
+TEST_F(CPPOMDPTest, StepBatchMatchesStep)
+{
+    for (int sc = 0; sc < 50; sc++) {
+        CPScenario scenario = RandomScenario(12);
+        const int num_targets = scenario.num_targets;
+        const double delta_t = (sc % 2) ? 1.0 : 2.0;
+        vehicle_model_->delta_t_ = delta_t;
+        CPPOMDP model(150, 0.5, delta_t, vehicle_model_, operator_model_, &scenario);
+
+        std::vector<State*> particles;
+        for (int k = 0; k < 64; k++) {
+            CPState* state = static_cast<CPState*>(model.Allocate(-1, 1.0 / 64));
+            state->ego_pose = random_() % 100;
+            state->ego_speed = 2.8 + (random_() % 84) / 10.0;
+            state->ego_recog = random_();
+            state->risk_bin = random_();
+            state->req_time = (random_() % 3) * int(delta_t);
+            state->req_target = random_() % num_targets;
+            state->scenario_id = k;
+            particles.emplace_back(state);
+        }
+
+        CPParticleBatch batch;
+        batch.Load(particles);
+        for (int step = 0; step < 10 && batch.Size() > 0; step++) {
+            ACT_TYPE action = random_() % (num_targets + 1);
+            std::vector<double> rand_nums(batch.Size());
+            for (auto &r : rand_nums) r = NextDouble();
+
+            std::vector<CPState> expected(batch.Size());
+            for (int i = 0; i < batch.Size(); i++) batch.Store(i, &expected[i]);
+
+            model.StepBatch(batch, rand_nums.data(), action);
+            for (int i = 0; i < batch.Size(); i++) {
+                double reward;
+                OBS_TYPE obs;
+                bool terminal = model.Step(expected[i], rand_nums[i], action, reward, obs);
+
+                CPState state;
+                batch.Store(i, &state);
+                ASSERT_EQ(batch.reward[i], reward) << "scenario " << sc << " step " << step << " particle " << i;
+                ASSERT_EQ(batch.obs[i], obs);
+                ASSERT_EQ(bool(batch.terminal[i]), terminal);
+                ASSERT_EQ(state.ego_speed, expected[i].ego_speed);
+                ASSERT_EQ(state.ego_pose, expected[i].ego_pose);
+                ASSERT_EQ(state.ego_recog, expected[i].ego_recog);
+                ASSERT_EQ(state.req_time, expected[i].req_time);
+                ASSERT_EQ(state.req_target, expected[i].req_target);
+            }
+            batch.RemoveTerminal();
+        }
+
+        for (auto particle : particles) model.Free(particle);
+    }
+}
+
+
+/* DefaultPolicy::Value as despot runs it: Step one particle at a time and recurse into every observation branch */
+static ValuedAction ReferenceValue(const DSPOMDP* model, const DefaultPolicy* policy, const int init_depth,
+                                   const std::vector<State*>& particles, RandomStreams& streams, History& history)
+{
+    if (streams.Exhausted() || int(history.Size()) - init_depth >= Globals::config.max_policy_sim_len) {
+        return ValuedAction(0, 0);
+    }
+
+    ACT_TYPE action = policy->Action(particles, streams, history);
+    double value = 0;
+    std::map<OBS_TYPE, std::vector<State*>> partitions;
+    for (auto particle : particles) {
+        double reward;
+        OBS_TYPE obs;
+        bool terminal = model->Step(*particle, streams.Entry(particle->scenario_id), action, reward, obs);
+        value += reward * particle->weight;
+        if (!terminal) partitions[obs].emplace_back(particle);
+    }
+
+    for (auto &partition : partitions) {
+        history.Add(action, partition.first);
+        streams.Advance();
+        value += Globals::config.discount * ReferenceValue(model, policy, init_depth, partition.second, streams, history).value;
+        streams.Back();
+        history.RemoveLast();
+    }
+    return ValuedAction(action, value);
+}
+
+
+/* the batched rollout of CPDefaultPolicy::Value gives the value of the per particle recursion
+ * and leaves the streams and the history as it found them
+ */
+TEST_F(CPPOMDPTest, DefaultPolicyValueMatchesReference)
+{
+    const int max_policy_sim_len = Globals::config.max_policy_sim_len;
+    const double discount = Globals::config.discount;
+    Globals::config.max_policy_sim_len = 25;
+    Globals::config.discount = 0.95;
+
+    for (int sc = 0; sc < 30; sc++) {
+        CPScenario scenario = RandomScenario(8);
+        const int num_targets = scenario.num_targets;
+        vehicle_model_->delta_t_ = 1.0;
+        CPPOMDP model(150, 0.5, 1.0, vehicle_model_, operator_model_, &scenario);
+        DefaultPolicy* policy = static_cast<DefaultPolicy*>(model.CreateScenarioLowerBound("DEFAULT", "DEFAULT"));
+
+        /* particles of one belief share the observable part of the state */
+        const int num_particles = 50;
+        const int req_time = random_() % 2;
+        const int req_target = random_() % num_targets;
+        const double ego_speed = 2.8 + (random_() % 84) / 10.0;
+        const uint64_t ego_recog = random_();
+        std::vector<State*> particles;
+        std::vector<State*> copies;
+        for (int k = 0; k < num_particles; k++) {
+            CPState* state = static_cast<CPState*>(model.Allocate(-1, 1.0 / num_particles));
+            state->ego_pose = 0;
+            state->ego_speed = ego_speed;
+            state->ego_recog = ego_recog;
+            state->risk_bin = random_();
+            state->req_time = req_time;
+            state->req_target = req_target;
+            state->scenario_id = k;
+            particles.emplace_back(state);
+            copies.emplace_back(model.Copy(state));
+        }
+
+        RandomStreams streams(num_particles, 40);
+        History history;
+        history.Add(random_() % (num_targets + 1), 1);
+
+        double expected = ReferenceValue(&model, policy, history.Size(), copies, streams, history).value;
+        double value = policy->Value(particles, streams, history).value;
+        EXPECT_NEAR(value, expected, 1e-6) << "scenario " << sc;
+        EXPECT_EQ(streams.position(), 0);
+        EXPECT_EQ(int(history.Size()), 1);
+
+        for (auto particle : particles) model.Free(particle);
+        for (auto particle : copies) model.Free(particle);
+        delete policy;
+    }
+
+    Globals::config.max_policy_sim_len = max_policy_sim_len;
+    Globals::config.discount = discount;
+}
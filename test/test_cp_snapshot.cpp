@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "cooperative_perception/cp_snapshot.hpp"
+
+
+TEST(CPSnapshot, LatestValue)
+{
+    CPSnapshot<int> snapshot;
+    EXPECT_FALSE(snapshot.HasValue());
+    EXPECT_FALSE(snapshot.Update());
+
+    snapshot.Back() = 1;
+    snapshot.Publish();
+    snapshot.Back() = 2;
+    snapshot.Publish();
+    ASSERT_TRUE(snapshot.Update());
+    EXPECT_TRUE(snapshot.HasValue());
+    EXPECT_EQ(snapshot.Front(), 2);
+
+    /* nothing new, the front is kept */
+    EXPECT_FALSE(snapshot.Update());
+    EXPECT_EQ(snapshot.Front(), 2);
+}
+
+
+/* the reader never sees a value torn between two publishes and never goes back in time */
+TEST(CPSnapshot, CompleteValuesAcrossThreads)
+{
+    struct Pair {
+        uint64_t a = 0;
+        uint64_t b = 0;
+    };
+    CPSnapshot<Pair> snapshot;
+    const uint64_t num = 200000;
+    std::thread writer([&] {
+        for (uint64_t i = 1; i <= num; i++) {
+            snapshot.Back().a = i;
+            snapshot.Back().b = ~i;
+            snapshot.Publish();
+        }
+    });
+
+    uint64_t last = 0;
+    bool is_consistent = true;
+    while (last < num) {
+        if (!snapshot.Update()) {
+            std::this_thread::yield();
+            continue;
+        }
+        const Pair &value = snapshot.Front();
+        if (value.b != ~value.a || value.a < last) {
+            is_consistent = false;
+            break;
+        }
+        last = value.a;
+    }
+    writer.join();
+    EXPECT_TRUE(is_consistent);
+}
@@ -0,0 +1,50 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include "cooperative_perception/cp_spsc_queue.hpp"
+
+
+TEST(CPSpscQueue, FullAndEmpty)
+{
+    CPSpscQueue<int> queue(3); // rounded up to 4
+    int value;
+    EXPECT_FALSE(queue.Pop(value));
+    for (int i = 0; i < 4; i++) EXPECT_TRUE(queue.Push(i));
+    EXPECT_FALSE(queue.Push(4));
+
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(queue.Pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.Pop(value));
+}
+
+
+TEST(CPSpscQueue, KeepsOrderAcrossThreads)
+{
+    CPSpscQueue<uint64_t> queue(64);
+    const uint64_t num = 200000;
+    std::thread producer([&] {
+        for (uint64_t i = 1; i <= num;) {
+            if (queue.Push(i)) {
+                i++;
+                continue;
+            }
+            std::this_thread::yield();
+        }
+    });
+
+    uint64_t expect = 1;
+    while (expect <= num) {
+        uint64_t value;
+        if (!queue.Pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (value != expect) break;
+        expect++;
+    }
+    producer.join();
+    EXPECT_EQ(expect, num + 1);
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+
+#include "cooperative_perception/cp_trajectory_index.hpp"
+
+
+/* smallest index below limit within radius, every point compared */
+static int LinearFirstWithin(const std::vector<double> &xs, const std::vector<double> &ys,
+                             const double x, const double y, const double radius, const int limit)
+{
+    for (int i = 0; i < limit && i < int(xs.size()); i++) {
+        if (std::hypot(x - xs[i], y - ys[i]) < radius) return i;
+    }
+    return -1;
+}
+
+
+/* curved trajectory with 0.5-1.5 m spacing, as the planner publishes it */
+static void RandomTrajectory(std::mt19937 &random, const int num, std::vector<double> &xs, std::vector<double> &ys)
+{
+    std::uniform_real_distribution<double> step(0.5, 1.5);
+    std::uniform_real_distribution<double> turn(-0.1, 0.1);
+    double x = 0.0, y = 0.0, yaw = 0.0;
+    xs.clear();
+    ys.clear();
+    for (int i = 0; i < num; i++) {
+        xs.emplace_back(x);
+        ys.emplace_back(y);
+        yaw += turn(random);
+        double ds = step(random);
+        x += ds * std::cos(yaw);
+        y += ds * std::sin(yaw);
+    }
+}
+
+
+TEST(CPTrajectoryIndex, Empty)
+{
+    CPTrajectoryIndex index;
+    index.Build({}, {}, 3.0);
+    EXPECT_EQ(index.Size(), 0);
+    EXPECT_EQ(index.FirstWithin(0.0, 0.0, 3.0, 0), -1);
+}
+
+
+TEST(CPTrajectoryIndex, ArcLength)
+{
+    CPTrajectoryIndex index;
+    index.Build({0.0, 3.0, 3.0, -1.0}, {0.0, 4.0, 6.0, 6.0}, 3.0);
+    ASSERT_EQ(index.Size(), 4);
+    EXPECT_DOUBLE_EQ(index.ArcLength(0), 0.0);
+    EXPECT_DOUBLE_EQ(index.ArcLength(1), 5.0);
+    EXPECT_DOUBLE_EQ(index.ArcLength(2), 7.0);
+    EXPECT_DOUBLE_EQ(index.ArcLength(3), 11.0);
+    EXPECT_DOUBLE_EQ(index.X(3), -1.0);
+    EXPECT_DOUBLE_EQ(index.Y(3), 6.0);
+}
+
+
+/* radius queries (also at negative coordinates and across cell borders) give the index of the linear scan */
+TEST(CPTrajectoryIndex, MatchesLinearScan)
+{
+    std::mt19937 random(5);
+    const double radius = 3.0;
+    for (int t = 0; t < 20; t++) {
+        std::vector<double> xs, ys;
+        RandomTrajectory(random, 50 + random() % 300, xs, ys);
+        CPTrajectoryIndex index;
+        index.Build(xs, ys, radius);
+
+        std::uniform_int_distribution<int> point(0, xs.size() - 1);
+        std::uniform_real_distribution<double> offset(-2.0 * radius, 2.0 * radius);
+        for (int q = 0; q < 2000; q++) {
+            int i = point(random);
+            double x = xs[i] + offset(random);
+            double y = ys[i] + offset(random);
+            int limit = (q % 3 == 0) ? int(xs.size()) : int(random() % (xs.size() + 1));
+            ASSERT_EQ(index.FirstWithin(x, y, radius, limit), LinearFirstWithin(xs, ys, x, y, radius, limit))
+                << "trajectory " << t << " query (" << x << ", " << y << ") limit " << limit;
+        }
+    }
+}
+
+
+/* the search of CPRosInterface::GetCollisionPointAndRisk: first trajectory point reached by any path,
+ * a later path only wins with a strictly earlier point. compared with the double loop over every
+ * trajectory point and every path pose, sized by the containers (not by sizeof).
+ */
+TEST(CPTrajectoryIndex, CollisionPointMatchesDoubleLoop)
+{
+    std::mt19937 random(9);
+    const double radius = 3.0;
+    std::uniform_real_distribution<double> coord(-20.0, 220.0);
+    std::uniform_real_distribution<double> step(-2.0, 2.0);
+    for (int t = 0; t < 200; t++) {
+        std::vector<double> xs, ys;
+        RandomTrajectory(random, 20 + random() % 200, xs, ys);
+        CPTrajectoryIndex index;
+        index.Build(xs, ys, radius);
+
+        /* straight predicted paths of a few poses */
+        int num_paths = 1 + random() % 3;
+        std::vector<std::vector<std::pair<double, double>>> paths(num_paths);
+        for (auto &path : paths) {
+            double x = coord(random), y = coord(random) * 0.2, dx = step(random), dy = step(random);
+            for (int k = 0; k < 40; k++) {
+                path.emplace_back(x + k * dx, y + k * dy);
+            }
+        }
+
+        int expected_index = -1, expected_path = -1;
+        for (int i = 0; i < int(xs.size()) && expected_index < 0; i++) {
+            for (int j = 0; j < num_paths && expected_index < 0; j++) {
+                for (const auto &pose : paths[j]) {
+                    if (std::hypot(pose.first - xs[i], pose.second - ys[i]) < radius) {
+                        expected_index = i;
+                        expected_path = j;
+                        break;
+                    }
+                }
+            }
+        }
+
+        int traj_index = -1, hit_path = -1;
+        for (int j = 0; j < num_paths; j++) {
+            int limit = (traj_index < 0) ? index.Size() : traj_index;
+            for (const auto &pose : paths[j]) {
+                int i = index.FirstWithin(pose.first, pose.second, radius, limit);
+                if (i < 0) continue;
+                traj_index = i;
+                hit_path = j;
+                limit = i;
+            }
+        }
+        ASSERT_EQ(traj_index, expected_index) << "trajectory " << t;
+        ASSERT_EQ(hit_path, expected_path) << "trajectory " << t;
+    }
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+#include "cooperative_perception/cp_uuid.hpp"
+
+
+static CPUuid MakeUuid(std::mt19937_64 &rng, const int key_space)
+{
+    std::array<uint8_t, 16> uuid;
+    for (auto &b : uuid) b = rng() % key_space;
+    return CPUuid(uuid);
+}
+
+
+TEST(CPUuid, ArrayRoundTrip)
+{
+    std::array<uint8_t, 16> uuid;
+    for (int i = 0; i < 16; i++) uuid[i] = i + 1;
+    CPUuid key(uuid);
+    EXPECT_EQ(key.ToArray(), uuid);
+
+    uuid[15] = 0;
+    EXPECT_NE(CPUuid(uuid), key);
+}
+
+
+TEST(CPUuidTable, InsertFindErase)
+{
+    std::array<uint8_t, 16> uuid{};
+    CPUuidTable<int> table;
+    EXPECT_EQ(table.Find(CPUuid(uuid)), -1);
+
+    for (int i = 0; i < 100; i++) {
+        uuid[0] = i;
+        bool is_new = false;
+        int pos = table.Insert(CPUuid(uuid), &is_new);
+        EXPECT_TRUE(is_new);
+        EXPECT_EQ(pos, i);
+        table.ValueAt(pos) = i * 10;
+    }
+    EXPECT_EQ(table.Size(), 100);
+
+    /* positions do not move when the probe array grows */
+    for (int i = 0; i < 100; i++) {
+        uuid[0] = i;
+        EXPECT_EQ(table.Find(CPUuid(uuid)), i);
+        EXPECT_EQ(*table.Get(CPUuid(uuid)), i * 10);
+    }
+
+    /* EraseAt moves the last entry into the hole */
+    uuid[0] = 99;
+    CPUuid last(uuid);
+    table.EraseAt(3);
+    EXPECT_EQ(table.Size(), 99);
+    EXPECT_EQ(table.KeyAt(3), last);
+    EXPECT_EQ(table.ValueAt(3), 990);
+    uuid[0] = 3;
+    EXPECT_EQ(table.Get(CPUuid(uuid)), nullptr);
+    EXPECT_FALSE(table.Erase(CPUuid(uuid)));
+
+    table.Clear();
+    EXPECT_EQ(table.Size(), 0);
+    uuid[0] = 10;
+    EXPECT_EQ(table.Find(CPUuid(uuid)), -1);
+}
+
+
+/* random operations against std::map, a small key space makes the probe chains collide */
+TEST(CPUuidTable, MatchesStdMap)
+{
+    std::mt19937_64 rng(1);
+    std::vector<CPUuid> keys;
+    for (int i = 0; i < 200; i++) keys.emplace_back(MakeUuid(rng, 4));
+
+    CPUuidTable<int> table;
+    std::map<std::pair<uint64_t, uint64_t>, int> ref;
+    for (int it = 0; it < 200000; it++) {
+        const CPUuid &key = keys[rng() % keys.size()];
+        auto ref_key = std::make_pair(key.hi, key.lo);
+        switch (rng() % 3) {
+        case 0:
+            table[key] = it;
+            ref[ref_key] = it;
+            break;
+        case 1:
+            ASSERT_EQ(table.Erase(key), ref.erase(ref_key) == 1);
+            break;
+        default:
+            const int *value = table.Get(key);
+            auto itr = ref.find(ref_key);
+            ASSERT_EQ(value == nullptr, itr == ref.end());
+            if (value != nullptr) {
+                ASSERT_EQ(*value, itr->second);
+            }
+        }
+        ASSERT_EQ(table.Size(), int(ref.size()));
+    }
+
+    /* every entry is reachable at its position */
+    for (int i = 0; i < table.Size(); i++) {
+        EXPECT_EQ(table.Find(table.KeyAt(i)), i);
+    }
+}
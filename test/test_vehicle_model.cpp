@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "cooperative_perception/libgeometry.hpp"
+#include "cooperative_perception/vehicle_model.hpp"
+
+using despot::CPScenario;
+
+
+/* GetAccel as it was before the sorted target window: every target visited, one candidate per target */
+static double ReferenceGetAccel(const VehicleModel &model, const double speed, const int pose, const uint64_t recog_mask,
+                                const int* target_poses, const int num_targets)
+{
+    std::vector<double> acc_list;
+    for (int i = 0; i < num_targets; i++) {
+        bool recog = (recog_mask >> i) & 1ULL;
+        int distance = target_poses[i] - pose;
+        double emergency_decel_dist = model.GetDecelDistance(speed, model.max_decel_, 0.0);
+        double comf_decel_dist = model.GetDecelDistance(speed, model.min_decel_, model.safety_margin_);
+
+        if (distance < 0 || comf_decel_dist + 10 < distance || recog == false) continue;
+        if (distance > comf_decel_dist) {
+            acc_list.emplace_back((std::pow(model.yield_speed_, 2.0) - std::pow(speed, 2.0))/(2.0*(distance+model.safety_margin_)));
+        }
+        else if (distance > emergency_decel_dist) {
+            acc_list.emplace_back((std::pow(model.yield_speed_, 2.0) - std::pow(speed, 2.0))/(2.0*(distance)));
+        }
+        else {
+            acc_list.emplace_back(-model.max_decel_);
+        }
+    }
+
+    if (speed < model.max_speed_ || speed < model.yield_speed_) {
+        acc_list.emplace_back(model.max_accel_);
+    }
+
+    double min_acc = 1000.0;
+    for (const auto acc : acc_list) {
+        if (acc < min_acc) min_acc = acc;
+    }
+    return min_acc;
+}
+
+
+static std::vector<int> SortedIndex(const std::vector<int> &poses)
+{
+    std::vector<int> idx(poses.size());
+    for (size_t i = 0; i < idx.size(); i++) idx[i] = i;
+    std::stable_sort(idx.begin(), idx.end(), [&poses](const int a, const int b) { return poses[a] < poses[b]; });
+    return idx;
+}
+
+
+/* same value, bit for bit, on random layouts (targets behind, ahead, beyond the braking envelope, same pose) */
+TEST(VehicleModel, GetAccelMatchesReference)
+{
+    VehicleModel model;
+    std::mt19937 random(1);
+    for (int it = 0; it < 200000; it++) {
+        int num_targets = random() % 20;
+        std::vector<int> poses(num_targets);
+        for (auto &p : poses) p = random() % 200;
+        std::vector<int> sorted_idx = SortedIndex(poses);
+
+        uint64_t recog_mask = random();
+        double speed = (random() % 1000) / 1000.0 * (model.max_speed_ + 1.0);
+        int pose = random() % 200;
+        ASSERT_EQ(model.GetAccel(speed, pose, recog_mask, poses.data(), sorted_idx.data(), num_targets),
+                  ReferenceGetAccel(model, speed, pose, recog_mask, poses.data(), num_targets))
+            << "speed " << speed << " pose " << pose << " targets " << num_targets;
+    }
+}
+
+
+TEST(VehicleModel, GetAccelWithoutTargets)
+{
+    VehicleModel model;
+    EXPECT_EQ(model.GetAccel(0.0, 0, 0, nullptr, nullptr, 0), model.max_accel_);
+    EXPECT_EQ(model.GetAccel(model.max_speed_, 0, 0, nullptr, nullptr, 0), 1000.0);
+}
+
+
+static CPScenario RandomScenario(std::mt19937 &random)
+{
+    CPScenario scenario;
+    int num_targets = 1 + random() % 10;
+    for (int i = 0; i < num_targets; i++) {
+        scenario.AddTarget(random() % 150, 0);
+    }
+    scenario.SortTargets();
+    return scenario;
+}
+
+
+static void Transition(const VehicleModel &model, const CPScenario &scenario, const uint64_t layout_id,
+                       double &speed, int &pose, const uint64_t recog_mask)
+{
+    model.GetTransition(speed, pose, recog_mask, scenario.risk_pose.data(), scenario.sorted_idx.data(), scenario.num_targets, layout_id);
+}
+
+
+TEST(VehicleModel, LayoutIdChangesWithTheTargets)
+{
+    CPScenario scenario;
+    scenario.Clear();
+    uint64_t empty_id = scenario.layout_id;
+    EXPECT_NE(empty_id, 0u);
+    scenario.AddTarget(10, 0);
+    EXPECT_NE(scenario.layout_id, empty_id);
+
+    /* copies share the layout and its cache */
+    CPScenario copy = scenario;
+    EXPECT_EQ(copy.layout_id, scenario.layout_id);
+    copy.AddTarget(20, 0);
+    EXPECT_NE(copy.layout_id, scenario.layout_id);
+}
+
+
+/* a cached transition is the transition from the quantized speed, on the first and on later calls */
+TEST(VehicleModel, CachedTransitionMatchesUncached)
+{
+    VehicleModel model(2.0);
+    std::mt19937 random(3);
+    for (int sc = 0; sc < 50; sc++) {
+        CPScenario scenario = RandomScenario(random);
+        model.ResetTransitionCache(scenario.layout_id);
+        for (int q = 0; q < 200; q++) {
+            double start_speed = model.yield_speed_ + (random() % 1000) / 1000.0 * (model.max_speed_ - model.yield_speed_);
+            int start_pose = random() % 150;
+            uint64_t recog_mask = random() % 8;
+
+            double expected_speed = std::lround(start_speed / model.cache_speed_res_) * model.cache_speed_res_;
+            int expected_pose = start_pose;
+            Transition(model, scenario, 0, expected_speed, expected_pose, recog_mask);
+
+            double speed = start_speed;
+            int pose = start_pose;
+            Transition(model, scenario, scenario.layout_id, speed, pose, recog_mask);
+            ASSERT_EQ(speed, expected_speed);
+            ASSERT_EQ(pose, expected_pose);
+
+            /* hit */
+            speed = start_speed;
+            pose = start_pose;
+            Transition(model, scenario, scenario.layout_id, speed, pose, recog_mask);
+            ASSERT_EQ(speed, expected_speed);
+            ASSERT_EQ(pose, expected_pose);
+        }
+    }
+}
+
+
+/* a layout other than the one the cache was reset for never reads it */
+TEST(VehicleModel, CacheIsKeyedOnTheLayout)
+{
+    VehicleModel model(2.0);
+    std::mt19937 random(4);
+    for (int sc = 0; sc < 50; sc++) {
+        CPScenario cached = RandomScenario(random);
+        CPScenario other = RandomScenario(random);
+        model.ResetTransitionCache(cached.layout_id);
+
+        std::set<int> start_poses;
+        for (int q = 0; q < 100; q++) {
+            int start_pose = random() % 150;
+            start_poses.insert(start_pose);
+            uint64_t recog_mask = ~0ULL;
+
+            double speed = model.max_speed_;
+            int pose = start_pose;
+            Transition(model, cached, cached.layout_id, speed, pose, recog_mask);
+
+            /* same key on another layout */
+            double expected_speed = model.max_speed_;
+            int expected_pose = start_pose;
+            Transition(model, other, 0, expected_speed, expected_pose, recog_mask);
+            speed = model.max_speed_;
+            pose = start_pose;
+            Transition(model, other, other.layout_id, speed, pose, recog_mask);
+            ASSERT_EQ(speed, expected_speed);
+            ASSERT_EQ(pose, expected_pose);
+        }
+
+        /* only the queries on the cached layout went through the cache */
+        std::stringstream stats;
+        model.PrintCacheStats(stats);
+        std::string counts = "hit: " + std::to_string(100 - start_poses.size()) + " miss: " + std::to_string(start_poses.size()) + " ";
+        EXPECT_NE(stats.str().find(counts), std::string::npos) << stats.str();
+    }
+}